@@ -0,0 +1,738 @@
+#include "guardian_core.h"
+#include <sstream>
+#include <cctype>
+#include <algorithm>
+
+namespace sns_guardian {
+
+std::string js_escape(const std::string& input) {
+    std::string out;
+    out.reserve(input.size());
+    for (char c : input) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '\'': out += "\\'"; break;
+        case '`': out += "\\`"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: out.push_back(c); break;
+        }
+    }
+    return out;
+}
+
+std::string provider_to_string(AnalysisProvider provider) {
+    switch (provider) {
+    case AnalysisProvider::Gemini: return "gemini";
+    case AnalysisProvider::LocalHeuristic: return "local";
+    case AnalysisProvider::Hedged: return "hedged";
+    default: return "api";
+    }
+}
+
+AnalysisProvider string_to_provider(const std::string& value) {
+    std::string lower = value;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (lower == "gemini") return AnalysisProvider::Gemini;
+    if (lower == "local" || lower == "heuristic") return AnalysisProvider::LocalHeuristic;
+    if (lower == "hedged") return AnalysisProvider::Hedged;
+    return AnalysisProvider::Api;
+}
+
+GVariant* settings_to_variant(const GuardianSettings& settings) {
+    GVariantDict dict;
+    g_variant_dict_init(&dict, nullptr);
+    g_variant_dict_insert(&dict, "api_url", "s", settings.api_url.c_str());
+    g_variant_dict_insert(&dict, "gemini_model", "s", settings.gemini_model.c_str());
+    g_variant_dict_insert(&dict, "provider", "s", provider_to_string(settings.provider).c_str());
+    g_variant_dict_insert(&dict, "gemini_configured", "b", settings.gemini_configured);
+    g_variant_dict_insert(&dict, "enable_analysis", "b", settings.enable_analysis);
+    g_variant_dict_insert(&dict, "enable_pattern", "b", settings.enable_pattern);
+    g_variant_dict_insert(&dict, "annotate_timeline", "b", settings.annotate_timeline);
+    g_variant_dict_insert(&dict, "deadline_ms", "i", settings.deadline_ms);
+    return g_variant_dict_end(&dict);
+}
+
+GuardianSettings settings_from_variant(GVariant* variant) {
+    GuardianSettings settings{};
+    if (!variant || !g_variant_is_of_type(variant, G_VARIANT_TYPE_VARDICT)) return settings;
+
+    GVariantDict dict;
+    g_variant_dict_init(&dict, variant);
+    const char* value = nullptr;
+    if (g_variant_dict_lookup(&dict, "api_url", "&s", &value)) settings.api_url = value;
+    if (g_variant_dict_lookup(&dict, "gemini_model", "&s", &value)) settings.gemini_model = value;
+    if (g_variant_dict_lookup(&dict, "provider", "&s", &value)) settings.provider = string_to_provider(value);
+    gboolean flag = FALSE;
+    if (g_variant_dict_lookup(&dict, "gemini_configured", "b", &flag)) settings.gemini_configured = flag;
+    if (g_variant_dict_lookup(&dict, "enable_analysis", "b", &flag)) settings.enable_analysis = flag;
+    if (g_variant_dict_lookup(&dict, "enable_pattern", "b", &flag)) settings.enable_pattern = flag;
+    if (g_variant_dict_lookup(&dict, "annotate_timeline", "b", &flag)) settings.annotate_timeline = flag;
+    g_variant_dict_lookup(&dict, "deadline_ms", "i", &settings.deadline_ms);
+    g_variant_dict_clear(&dict);
+    return settings;
+}
+
+// ページ側 localAnalysis() と同じ判定をネイティブで行う（タイムライン注釈用）
+LocalRisk score_text_locally(const std::string& text) {
+    static const char* sensitive_words[] = {"kill", "死ね", "バカ", "最低", "馬鹿", "ばか", "stupid", "idiot"};
+
+    LocalRisk risk;
+    risk.score = 0.08;
+
+    std::string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (g_utf8_strlen(text.c_str(), -1) > 240) { risk.score += 0.12; risk.factors.push_back("長文は誤解されやすい"); }
+
+    int upper_run = 0;
+    bool shouting = text.find("!!") != std::string::npos;
+    for (char c : text) {
+        upper_run = (c >= 'A' && c <= 'Z') ? upper_run + 1 : 0;
+        if (upper_run >= 6) { shouting = true; break; }
+    }
+    if (shouting) { risk.score += 0.12; risk.factors.push_back("強い表現が含まれています"); }
+
+    for (const char* word : sensitive_words) {
+        if (lower.find(word) != std::string::npos) {
+            risk.score += 0.2;
+            risk.factors.push_back("攻撃的な単語を検知");
+            break;
+        }
+    }
+
+    if (text.find("http") != std::string::npos) { risk.score += 0.05; risk.factors.push_back("リンク共有"); }
+
+    risk.score = std::min(risk.score, 0.95);
+    risk.level = risk.score > 0.45 ? "high" : risk.score > 0.25 ? "medium" : "low";
+    return risk;
+}
+
+std::string json_builder_to_string(JsonBuilder* builder, bool pretty) {
+    JsonNode* root = json_builder_get_root(builder);
+    JsonGenerator* generator = json_generator_new();
+    json_generator_set_root(generator, root);
+    json_generator_set_pretty(generator, pretty);
+    gchar* data = json_generator_to_data(generator, nullptr);
+    std::string json = data;
+
+    g_free(data);
+    g_object_unref(generator);
+    json_node_unref(root);
+    g_object_unref(builder);
+    return json;
+}
+
+std::string score_posts_json(const std::vector<std::pair<std::string, std::string>>& posts) {
+    JsonBuilder* builder = json_builder_new();
+    json_builder_begin_array(builder);
+    for (const auto& [id, text] : posts) {
+        LocalRisk risk = score_text_locally(text);
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "id");
+        json_builder_add_string_value(builder, id.c_str());
+        json_builder_set_member_name(builder, "level");
+        json_builder_add_string_value(builder, risk.level.c_str());
+        json_builder_set_member_name(builder, "score");
+        json_builder_add_double_value(builder, risk.score);
+        json_builder_set_member_name(builder, "factors");
+        json_builder_begin_array(builder);
+        for (const auto& factor : risk.factors) json_builder_add_string_value(builder, factor.c_str());
+        json_builder_end_array(builder);
+        json_builder_end_object(builder);
+    }
+    json_builder_end_array(builder);
+
+    return json_builder_to_string(builder);
+}
+
+std::string jsc_string_property(JSCValue* object, const char* name) {
+    JSCValue* property = jsc_value_object_get_property(object, name);
+    std::string result;
+    if (jsc_value_is_string(property)) {
+        char* value_c = jsc_value_to_string(property);
+        result = value_c;
+        g_free(value_c);
+    }
+    g_object_unref(property);
+    return result;
+}
+
+int jsc_int_property(JSCValue* object, const char* name) {
+    JSCValue* property = jsc_value_object_get_property(object, name);
+    int result = jsc_value_is_number(property) ? jsc_value_to_int32(property) : 0;
+    g_object_unref(property);
+    return result;
+}
+
+std::vector<std::pair<std::string, std::string>> posts_from_jsc(JSCValue* value) {
+    std::vector<std::pair<std::string, std::string>> posts;
+    if (!jsc_value_is_array(value)) return posts;
+
+    JSCValue* length_value = jsc_value_object_get_property(value, "length");
+    int length = jsc_value_to_int32(length_value);
+    g_object_unref(length_value);
+    for (int i = 0; i < length && static_cast<int>(posts.size()) < kPostBatchSize; ++i) {
+        JSCValue* item = jsc_value_object_get_property_at_index(value, i);
+        if (!jsc_value_is_object(item)) {
+            g_object_unref(item);
+            continue;
+        }
+        std::string id = jsc_string_property(item, "id");
+        if (!id.empty()) posts.emplace_back(id, jsc_string_property(item, "text"));
+        g_object_unref(item);
+    }
+    return posts;
+}
+
+std::string build_guardian_script(const GuardianSettings& settings) {
+    std::ostringstream script;
+    script << R"JS(
+(function() {
+    console.log('[SNS Guardian] Script starting...');
+    
+    var settings = {
+        apiUrl: ')JS" << js_escape(settings.api_url) << R"JS(',
+        provider: ')JS" << provider_to_string(settings.provider) << R"JS(',
+        geminiConfigured: )JS" << (settings.gemini_configured ? "true" : "false") << R"JS(,
+        geminiModel: ')JS" << js_escape(settings.gemini_model) << R"JS(',
+        enableAnalysis: )JS" << (settings.enable_analysis ? "true" : "false") << R"JS(,
+        enablePattern: )JS" << (settings.enable_pattern ? "true" : "false") << R"JS(,
+        annotateTimeline: )JS" << (settings.annotate_timeline ? "true" : "false") << R"JS(,
+        promptVersion: ')JS" << kGeminiPromptVersion << R"JS(',
+        deadlineMs: )JS" << settings.deadline_ms << R"JS(
+    };
+    
+    console.log('[SNS Guardian] Settings loaded:', settings.provider, 'apiKey:', settings.geminiConfigured ? 'SET' : 'NOT SET');
+    
+    var h = location.hostname;
+    var platform = null;
+    if(h.includes('twitter.com') || h.includes('x.com')) platform = 'x';
+    else if(h.includes('mastodon')) platform = 'mastodon';
+    else if(h.includes('bsky.app')) platform = 'bluesky';
+    
+    console.log('[SNS Guardian] Platform:', platform);
+    if(!platform) return;
+    
+    // ネイティブ側への窓口。Web プロセス拡張で動くときは隔離ワールドに sgNative が用意される
+    var nativeBridge = window.sgNative || {
+        kind: 'script',
+        has: function(name) {
+            return !!(window.webkit && window.webkit.messageHandlers && window.webkit.messageHandlers[name]);
+        },
+        post: function(name, message) {
+            window.webkit.messageHandlers[name].postMessage(message);
+        }
+    };
+    console.log('[SNS Guardian] Native bridge:', nativeBridge.kind);
+    
+    var sensitiveWords = ['kill', '死ね', 'バカ', '最低', '馬鹿', 'ばか', 'stupid', 'idiot'];
+    
+    function localAnalysis(text) {
+        console.log('[SNS Guardian] Local analysis...');
+        var score = 0.08;
+        var factors = [];
+        var lower = text.toLowerCase();
+        
+        if(text.length > 240) { score += 0.12; factors.push('長文は誤解されやすい'); }
+        if(/!{2,}/.test(text) || /[A-Z]{6,}/.test(text)) { score += 0.12; factors.push('強い表現が含まれています'); }
+        
+        for(var i = 0; i < sensitiveWords.length; i++) {
+            if(lower.includes(sensitiveWords[i].toLowerCase())) {
+                score += 0.2;
+                factors.push('攻撃的な単語を検知');
+                break;
+            }
+        }
+        
+        if(text.includes('http')) { score += 0.05; factors.push('リンク共有'); }
+        
+        score = Math.min(score, 0.95);
+        var level = score > 0.45 ? 'high' : score > 0.25 ? 'medium' : 'low';
+        
+        return { level: level, score: score, factors: factors };
+    }
+    
+    // リロード前のリクエストとIDが衝突しないよう時刻から始める
+    var remoteSeq = Date.now() % 1000000000;
+    var remotePending = new Map();
+    var geminiCache = new Map();
+    
+    // ネイティブ側の結果は window.guardianRemoteCallback(id, json) で届く
+    window.guardianRemoteCallback = function(id, jsonStr) {
+        var pending = remotePending.get(id);
+        if(!pending) return;
+        remotePending.delete(id);
+        clearTimeout(pending.timeoutId);
+        console.log('[SNS Guardian] Callback received:', id, jsonStr ? jsonStr.substring(0, 100) : 'empty');
+        
+        if(!jsonStr) {
+            pending.resolve({ error: 'Empty response' });
+            return;
+        }
+        
+        try {
+            var analysis = JSON.parse(jsonStr);
+            console.log('[SNS Guardian] Parsed analysis:', analysis);
+            
+            // APIエラーをチェック（429 quota exceededなど）
+            if(analysis.error) {
+                var errCode = analysis.error.code;
+                var errMsg = typeof analysis.error === 'string' ? analysis.error : (analysis.error.message || 'Unknown error');
+                var error = errCode === 429 ? 'API quota exceeded (429)' :
+                    errCode ? 'API error ' + errCode + ': ' + errMsg.substring(0, 50) : errMsg.substring(0, 80);
+                console.log('[SNS Guardian] API error detected:', error);
+                pending.resolve({ error: error });
+                return;
+            }
+            
+            pending.resolve({ analysis: analysis });
+        } catch(e) {
+            console.log('[SNS Guardian] Parse error:', e.message, jsonStr.substring(0, 50));
+            pending.resolve({ error: 'Parse error' });
+        }
+    };
+    
+    function cancelRemote(id, reason) {
+        var pending = remotePending.get(id);
+        if(!pending) return;
+        remotePending.delete(id);
+        clearTimeout(pending.timeoutId);
+        console.log('[SNS Guardian] Cancel remote request:', id, reason || 'Cancelled');
+        pending.resolve({ error: reason || 'Cancelled' });
+        try {
+            nativeBridge.post('cancelRemote', id);
+        } catch(e) {}
+    }
+    
+    function startRemote(handlerName, message) {
+        var id = ++remoteSeq;
+        message.id = id;
+        message.handler = handlerName;
+        var promise = new Promise(function(resolve) {
+            if(!nativeBridge.has(handlerName)) {
+                resolve({ error: 'Native handler not available' });
+                return;
+            }
+            var timeoutId = setTimeout(function() { cancelRemote(id, 'Timeout'); }, 15000);
+            remotePending.set(id, { resolve: resolve, timeoutId: timeoutId });
+            
+            try {
+                nativeBridge.post(handlerName, message);
+            } catch(e) {
+                console.log('[SNS Guardian] PostMessage error:', e);
+                remotePending.delete(id);
+                clearTimeout(timeoutId);
+                resolve({ error: 'PostMessage failed' });
+            }
+        });
+        return { id: id, promise: promise };
+    }
+    
+    function startGemini(text, replyTo) {
+        if(!settings.geminiConfigured) return { id: 0, promise: Promise.resolve({ error: 'API key not set' }) };
+        
+        var cacheKey = settings.promptVersion + '|' + settings.geminiModel + '|' + replyTo + '|' + text;
+        if(geminiCache.has(cacheKey)) {
+            console.log('[SNS Guardian] Using cached Gemini result');
+            return { id: 0, promise: Promise.resolve({ analysis: geminiCache.get(cacheKey) }) };
+        }
+        
+        console.log('[SNS Guardian] Starting Gemini analysis...');
+        var request = startRemote('gemini', { text: text, replyTo: replyTo });
+        request.promise = request.promise.then(function(result) {
+            if(result.analysis) {
+                geminiCache.set(cacheKey, result.analysis);
+                if(geminiCache.size > 50) geminiCache.delete(geminiCache.keys().next().value);
+            }
+            return result;
+        });
+        return request;
+    }
+    
+    function startRest(text, replyTo) {
+        if(!settings.apiUrl) return { id: 0, promise: Promise.resolve({ error: 'API URL not set' }) };
+        console.log('[SNS Guardian] Starting REST analysis...');
+        return startRemote('rest', { text: text, replyTo: replyTo, platform: platform });
+    }
+    
+    function mergeRemote(result, providerName, local) {
+        var advanced = result.analysis;
+        if(!advanced || !advanced.risk_level) return null;
+        return {
+            level: advanced.risk_level,
+            score: advanced.risk_score || local.score,
+            factors: (advanced.risk_factors || []).concat(local.factors),
+            suggestions: advanced.suggestions || [],
+            usedProvider: providerName
+        };
+    }
+    
+    async function analyzeRisk(text, replyTo) {
+        console.log('[SNS Guardian] analyzeRisk, provider:', settings.provider);
+        var local = localAnalysis(text);
+        local.usedProvider = 'local';
+        
+        if(!settings.enableAnalysis || settings.provider === 'local') return local;
+        
+        var providerName = settings.provider === 'gemini' ? 'gemini' : 'api';
+        var request = providerName === 'gemini' ? startGemini(text, replyTo) : startRest(text, replyTo);
+        var result = await request.promise;
+        var merged = mergeRemote(result, providerName, local);
+        if(merged) {
+            console.log('[SNS Guardian] Using ' + providerName + ' result');
+            return merged;
+        }
+        
+        console.log('[SNS Guardian] ' + providerName + ' failed, using local. Error:', result.error);
+        local.usedProvider = providerName + ' (failed: ' + (result.error || 'no risk_level') + ')';
+        return local;
+    }
+    
+    // 期限付き並列評価: ローカル結果を即時に持ち、Gemini と REST を同時に投げる。
+    // 期限時点の最良の結果で initial を解決し、より良い結果が来たら onUpdate で差し替える。
+    var PROVIDER_RANK = { local: 0, api: 1, gemini: 2 };
+    
+    function analyzeHedged(text, replyTo) {
+        var local = localAnalysis(text);
+        local.usedProvider = 'local';
+        var best = local;
+        var bestRank = PROVIDER_RANK.local;
+        var delivered = false;
+        var resolveInitial = null;
+        
+        var requests = [
+            { name: 'gemini', request: startGemini(text, replyTo) },
+            { name: 'api', request: startRest(text, replyTo) }
+        ];
+        var outstanding = requests.length;
+        
+        var handle = {
+            initial: new Promise(function(resolve) { resolveInitial = resolve; }),
+            onUpdate: null,
+            cancel: function() {
+                requests.forEach(function(entry) { cancelRemote(entry.request.id); });
+            }
+        };
+        
+        function deliver() {
+            if(delivered) return;
+            delivered = true;
+            clearTimeout(deadlineId);
+            console.log('[SNS Guardian] Hedged result at deadline:', best.usedProvider);
+            resolveInitial(best);
+        }
+        var deadlineId = setTimeout(deliver, settings.deadlineMs);
+        
+        requests.forEach(function(entry) {
+            entry.request.promise.then(function(result) {
+                outstanding--;
+                var merged = mergeRemote(result, entry.name, local);
+                if(!merged && result.error) console.log('[SNS Guardian] Hedged ' + entry.name + ' failed:', result.error);
+                if(merged && PROVIDER_RANK[entry.name] > bestRank) {
+                    best = merged;
+                    bestRank = PROVIDER_RANK[entry.name];
+                    if(delivered && handle.onUpdate) handle.onUpdate(best);
+                }
+                // 最上位の結果が出たら残りは負けなので止めてクォータを節約する
+                if(bestRank === PROVIDER_RANK.gemini) handle.cancel();
+                if(outstanding === 0 || bestRank === PROVIDER_RANK.gemini) deliver();
+            });
+        });
+        
+        return handle;
+    }
+    
+    function renderAnalysis(analysis) {
+        var riskColor = analysis.level === 'high' ? '#ef4444' : analysis.level === 'medium' ? '#f59e0b' : '#22c55e';
+        var riskPercent = Math.round(analysis.score * 100);
+        return '<div style="background:#f1f5f9;padding:12px;border-radius:8px;margin-bottom:12px;">' +
+            '<div style="font-size:14px;color:#64748b;">リスクスコア</div>' +
+            '<div style="font-size:24px;font-weight:bold;color:' + riskColor + ';">' + riskPercent + '% (' + analysis.level + ')</div>' +
+            '<div style="font-size:11px;color:#94a3b8;margin-top:4px;">分析: ' + (analysis.usedProvider || 'unknown') + '</div>' +
+            '</div>' +
+            '<div style="margin-bottom:16px;">' +
+            '<div style="font-size:14px;font-weight:bold;color:#0f172a;margin-bottom:8px;">検出された要因:</div>' +
+            '<ul style="margin:0;padding-left:20px;color:#334155;">' + 
+            (analysis.factors && analysis.factors.length > 0 ? analysis.factors.map(function(f){ return '<li>' + f + '</li>'; }).join('') : '<li>特になし</li>') +
+            '</ul></div>';
+    }
+    
+    function showModal(analysis, onContinue, onCancel) {
+        var overlay = document.createElement('div');
+        overlay.style.cssText = 'position:fixed;inset:0;background:rgba(0,0,0,0.6);display:flex;align-items:center;justify-content:center;z-index:2147483647;';
+        
+        var modal = document.createElement('div');
+        modal.style.cssText = 'background:#fff;border-radius:12px;padding:20px;max-width:400px;width:90%;font-family:sans-serif;';
+        modal.innerHTML = '<h3 style="margin:0 0 16px;color:#0f172a;">送信前チェック</h3>' +
+            '<div id="sg-analysis">' + renderAnalysis(analysis) + '</div>' +
+            '<div style="display:flex;gap:8px;justify-content:flex-end;">' +
+            '<button id="sg-cancel" style="padding:10px 16px;border:1px solid #e2e8f0;background:#fff;border-radius:8px;cursor:pointer;font-weight:bold;">投稿を中止</button>' +
+            '<button id="sg-continue" style="padding:10px 16px;border:none;background:#2563eb;color:#fff;border-radius:8px;cursor:pointer;font-weight:bold;">それでも投稿</button></div>';
+        
+        overlay.appendChild(modal);
+        document.body.appendChild(overlay);
+        
+        modal.querySelector('#sg-cancel').onclick = function() { overlay.remove(); onCancel(); };
+        modal.querySelector('#sg-continue').onclick = function() { overlay.remove(); onContinue(); };
+        
+        return {
+            update: function(next) {
+                if(!overlay.isConnected) return;
+                console.log('[SNS Guardian] Modal updated:', next.usedProvider);
+                modal.querySelector('#sg-analysis').innerHTML = renderAnalysis(next);
+            }
+        };
+    }
+    
+    var buttonSelectors = platform === 'x' ? 
+        'button[data-testid="tweetButtonInline"],button[data-testid="tweetButton"],div[data-testid="tweetButtonInline"],div[data-testid="tweetButton"]' :
+        platform === 'mastodon' ? 'button[type="submit"]' : 'button[data-testid="composer-submit"]';
+    
+    var textSelectors = platform === 'x' ?
+        'div[data-testid="tweetTextarea_0"],div[role="textbox"][contenteditable="true"]' :
+        platform === 'mastodon' ? 'textarea' : 'textarea,div[role="textbox"]';
+    
+    // 押されたボタンと同じコンポーザー内の入力欄を探す
+    function composerTextFor(btn) {
+        for(var node = btn.parentElement; node; node = node.parentElement) {
+            var el = node.querySelector(textSelectors);
+            if(el) return el;
+        }
+        return null;
+    }
+    
+    // 返信コンポーザーが開いているときだけ返信先の本文を返す。
+    // 返信先は返信ダイアログ内、または投稿詳細ページのインライン返信欄の直前にある投稿
+    function replyContext(textEl) {
+        if(!textEl) return '';
+        if(platform === 'mastodon') {
+            var form = textEl.closest('.compose-form');
+            var indicator = form && form.querySelector('.reply-indicator__content');
+            return indicator ? (indicator.textContent || '').trim() : '';
+        }
+        var scope = textEl.closest('div[role="dialog"]');
+        if(!scope && /\/status\/|\/post\//.test(location.pathname)) scope = textEl.closest('main');
+        if(!scope) return '';
+        var target = null;
+        scope.querySelectorAll(originalPostSelectors).forEach(function(el) {
+            if(el.compareDocumentPosition(textEl) & Node.DOCUMENT_POSITION_FOLLOWING) target = el;
+        });
+        return target ? (target.textContent || '').trim() : '';
+    }
+    
+    var isUpdating = false;
+    // ページ側から読み書きできないよう、ガーディアンの状態は DOM 属性ではなくすべてスクリプト内に持つ
+    var boundButtons = new WeakSet();
+    var bypassButtons = new WeakSet();
+    
+    function attachToButtons() {
+        if(isUpdating) return;
+        isUpdating = true;
+        
+        var buttons = document.querySelectorAll(buttonSelectors);
+        
+        buttons.forEach(function(btn) {
+            if(boundButtons.has(btn)) return;
+            boundButtons.add(btn);
+            console.log('[SNS Guardian] Attached to button');
+            
+            btn.addEventListener('click', async function(e) {
+                if(bypassButtons.has(btn)) return;
+                
+                e.preventDefault();
+                e.stopPropagation();
+                var interceptedAt = performance.now();
+                
+                var textEl = composerTextFor(btn) || document.querySelector(textSelectors);
+                var text = textEl ? (textEl.textContent || textEl.value || '') : '';
+                console.log('[SNS Guardian] Intercepted, text:', text.substring(0, 30));
+                
+                var replyTo = replyContext(textEl);
+                var hedged = settings.enableAnalysis && settings.provider === 'hedged' ? analyzeHedged(text, replyTo) : null;
+                var analysis = hedged ? await hedged.initial : await analyzeRisk(text, replyTo);
+                
+                var modal = showModal(analysis, 
+                    function() {
+                        if(hedged) hedged.cancel();
+                        bypassButtons.add(btn);
+                        btn.click();
+                        setTimeout(function() { bypassButtons.delete(btn); }, 500);
+                    },
+                    function() {
+                        if(hedged) hedged.cancel();
+                    }
+                );
+                if(hedged) hedged.onUpdate = modal.update;
+                console.log('[SNS Guardian] Latency intercept->modal: ' + (performance.now() - interceptedAt).toFixed(1) + ' ms (' + nativeBridge.kind + ', ' + analysis.usedProvider + ')');
+            }, true);
+        });
+        
+        isUpdating = false;
+    }
+    
+    // タイムライン注釈: ビューポートに入った投稿だけをネイティブ側でまとめて採点する
+    var originalPostSelectors = platform === 'x' ?
+        'article[role="article"] div[data-testid="tweetText"]' :
+        platform === 'mastodon' ? '.status__content,.detailed-status__body' : 'div[data-testid="postThread"] article,article';
+    
+    var POST_BATCH_SIZE = )JS" << kPostBatchSize << R"JS(;
+    var POST_CACHE_LIMIT = 500;
+    var POST_TEXT_LIMIT = 1000;
+    var postCache = new Map();
+    var pendingPosts = new Map();
+    var inFlightPosts = new Map();
+    var postSentAt = new Map();
+    var paintQueue = [];
+    var flushScheduled = false;
+    var paintScheduled = false;
+    var postObserver = null;
+    var observedPosts = new WeakSet();
+    var postIds = new WeakMap();
+    var paintedRisk = new WeakMap();
+    
+    function postIdOf(el) {
+        if(postIds.has(el)) return postIds.get(el);
+        var container = el.closest('article,[data-id]') || el;
+        var id = container.getAttribute('data-id');
+        if(!id) {
+            var link = container.querySelector('a[href*="/status/"],a[href*="/post/"]');
+            if(link) id = link.getAttribute('href');
+        }
+        if(id && container !== el) {
+            // X の引用ポストは外側の投稿と同じ article に入るため、本文ごとに位置で区別する
+            var texts = container.querySelectorAll(originalPostSelectors);
+            if(texts.length > 1) id += '#' + Array.prototype.indexOf.call(texts, el);
+        }
+        if(!id) {
+            var text = el.textContent || '';
+            var hash = 0;
+            for(var i = 0; i < text.length; i++) hash = (hash * 31 + text.charCodeAt(i)) | 0;
+            id = 'h' + hash + ':' + text.length;
+        }
+        postIds.set(el, id);
+        return id;
+    }
+    
+    function schedulePaint(el, result) {
+        paintQueue.push([el, result]);
+        if(paintScheduled) return;
+        paintScheduled = true;
+        requestAnimationFrame(function() {
+            paintScheduled = false;
+            var queue = paintQueue;
+            paintQueue = [];
+            queue.forEach(function(item) {
+                if(!item[0].isConnected) return;
+                paintedRisk.set(item[0], item[1].level);
+                item[0].dataset.sgRisk = item[1].level;
+                if(item[1].factors.length > 0) item[0].title = 'SNS Guardian: ' + item[1].factors.join(' / ');
+            });
+        });
+    }
+    
+    function flushPendingPosts() {
+        flushScheduled = false;
+        if(pendingPosts.size === 0) return;
+        
+        var batch = [];
+        var sentAt = performance.now();
+        pendingPosts.forEach(function(el, id) {
+            if(batch.length >= POST_BATCH_SIZE) return;
+            batch.push({ id: id, text: (el.textContent || '').substring(0, POST_TEXT_LIMIT) });
+            inFlightPosts.set(id, el);
+            postSentAt.set(id, sentAt);
+        });
+        batch.forEach(function(item) { pendingPosts.delete(item.id); });
+        
+        try {
+            nativeBridge.post('guardianBatch', batch);
+        } catch(e) {
+            console.log('[SNS Guardian] Batch post error:', e);
+            batch.forEach(function(item) {
+                inFlightPosts.delete(item.id);
+                postSentAt.delete(item.id);
+            });
+        }
+        if(pendingPosts.size > 0) scheduleFlush();
+    }
+    
+    function scheduleFlush() {
+        if(flushScheduled) return;
+        flushScheduled = true;
+        // 高速スクロール中に通り過ぎた投稿はこの間に pendingPosts から外れる
+        if(window.requestIdleCallback) requestIdleCallback(flushPendingPosts, { timeout: 300 });
+        else setTimeout(flushPendingPosts, 150);
+    }
+    
+    window.guardianBatchCallback = function(results) {
+        if(results.length > 0 && postSentAt.has(results[0].id)) {
+            console.log('[SNS Guardian] Latency batch of ' + results.length + ': ' + (performance.now() - postSentAt.get(results[0].id)).toFixed(1) + ' ms (' + nativeBridge.kind + ')');
+        }
+        results.forEach(function(result) {
+            var el = inFlightPosts.get(result.id);
+            inFlightPosts.delete(result.id);
+            postSentAt.delete(result.id);
+            postCache.set(result.id, result);
+            if(postCache.size > POST_CACHE_LIMIT) postCache.delete(postCache.keys().next().value);
+            if(el) schedulePaint(el, result);
+        });
+    };
+    
+    function observePosts() {
+        if(!postObserver) return;
+        document.querySelectorAll(originalPostSelectors).forEach(function(el) {
+            if(observedPosts.has(el)) return;
+            observedPosts.add(el);
+            postObserver.observe(el);
+        });
+    }
+    
+    if(settings.annotateTimeline && nativeBridge.has('guardianBatch')) {
+        var riskStyle = document.createElement('style');
+        riskStyle.textContent = '[data-sg-risk="medium"]{box-shadow:inset 3px 0 0 #f59e0b;}[data-sg-risk="high"]{box-shadow:inset 3px 0 0 #ef4444;}';
+        document.head.appendChild(riskStyle);
+        
+        postObserver = new IntersectionObserver(function(entries) {
+            entries.forEach(function(entry) {
+                var el = entry.target;
+                if(!el.isConnected) { postObserver.unobserve(el); return; }
+                var id = postIdOf(el);
+                if(!entry.isIntersecting) {
+                    pendingPosts.delete(id);
+                    return;
+                }
+                var cached = postCache.get(id);
+                if(cached) {
+                    if(paintedRisk.get(el) !== cached.level) schedulePaint(el, cached);
+                } else if(inFlightPosts.has(id)) {
+                    inFlightPosts.set(id, el);
+                } else {
+                    pendingPosts.set(id, el);
+                    scheduleFlush();
+                }
+            });
+        }, { threshold: 0.25 });
+    }
+    
+    attachToButtons();
+    observePosts();
+    
+    var debounceTimer = null;
+    var observer = new MutationObserver(function() {
+        if(debounceTimer) clearTimeout(debounceTimer);
+        debounceTimer = setTimeout(function() {
+            attachToButtons();
+            observePosts();
+        }, 500);
+    });
+    observer.observe(document.body, { childList: true, subtree: true });
+    
+    console.log('[SNS Guardian] Initialization complete');
+})();
+)JS";
+    return script.str();
+}
+
+} // namespace sns_guardian
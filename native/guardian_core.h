@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glib.h>
+#include <jsc/jsc.h>
+#include <json-glib/json-glib.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// UI プロセス (sns_guardian_browser) と Web プロセス拡張 (sns_guardian_extension) の共通部分
+namespace sns_guardian {
+
+// プロンプトやスキーマを変更したら更新する（ページ側の分析キャッシュのキーに使われる）
+inline constexpr const char* kGeminiPromptVersion = "risk-v2";
+inline constexpr int kDefaultDeadlineMs = 800;
+// タイムライン注釈の1回あたりの採点件数（ページ側でも同じ値で分割する）
+inline constexpr int kPostBatchSize = 20;
+
+enum class AnalysisProvider {
+    Api,
+    Gemini,
+    LocalHeuristic,
+    Hedged
+};
+
+struct GuardianSettings {
+    std::string api_url = "http://localhost:8000/api/v1";
+    // API キー自体は UI プロセスの AppState だけが持ち、Web プロセスには設定済みかどうかだけを渡す
+    bool gemini_configured = false;
+    std::string gemini_model = "gemini-2.5-flash-lite-preview-09-2025";
+    AnalysisProvider provider = AnalysisProvider::LocalHeuristic;
+    bool enable_analysis = true;
+    bool enable_pattern = true;
+    bool annotate_timeline = true;
+    int deadline_ms = kDefaultDeadlineMs;
+};
+
+
+struct LocalRisk {
+    std::string level;
+    double score = 0.0;
+    std::vector<std::string> factors;
+};
+
+std::string js_escape(const std::string& input);
+std::string provider_to_string(AnalysisProvider provider);
+AnalysisProvider string_to_provider(const std::string& value);
+
+// 拡張の初期化データ・設定変更メッセージ用 (a{sv})
+GVariant* settings_to_variant(const GuardianSettings& settings);
+GuardianSettings settings_from_variant(GVariant* variant);
+
+// 組み立て終えた builder を JSON 文字列にして解放する
+std::string json_builder_to_string(JsonBuilder* builder, bool pretty = false);
+
+LocalRisk score_text_locally(const std::string& text);
+// [{"id","level","score","factors"}] の JSON 配列を返す
+std::string score_posts_json(const std::vector<std::pair<std::string, std::string>>& posts);
+
+std::string jsc_string_property(JSCValue* object, const char* name);
+int jsc_int_property(JSCValue* object, const char* name);
+// ページから届いた [{id, text}] を取り出す（オブジェクト以外は無視し、kPostBatchSize 件まで）
+std::vector<std::pair<std::string, std::string>> posts_from_jsc(JSCValue* value);
+
+std::string build_guardian_script(const GuardianSettings& settings);
+
+} // namespace sns_guardian
@@ -0,0 +1,156 @@
+#include <webkit2/webkit-web-extension.h>
+#include <gmodule.h>
+#include "guardian_core.h"
+#include <string>
+
+using namespace sns_guardian;
+
+namespace {
+
+// ガーディアンはページから触れない隔離ワールドで動かす。
+// ローカル採点はこのプロセス内で完結し、UI プロセスへ送るのは Gemini / REST のリクエストだけ。
+struct ExtensionState {
+    GuardianSettings settings{};
+    WebKitScriptWorld* world = nullptr;
+};
+
+ExtensionState extension_state;
+
+struct RemoteReply {
+    JSCContext* context = nullptr;
+    int id = 0;
+};
+
+gboolean bridge_has(const char* name, gpointer) {
+    return g_strcmp0(name, "gemini") == 0 || g_strcmp0(name, "rest") == 0 ||
+        g_strcmp0(name, "cancelRemote") == 0 || g_strcmp0(name, "guardianBatch") == 0;
+}
+
+void call_page_callback(JSCContext* context, const char* name, JSCValue* argument) {
+    JSCValue* callback = jsc_context_get_value(context, name);
+    if (jsc_value_is_function(callback)) {
+        JSCValue* result = jsc_value_function_call(callback, JSC_TYPE_VALUE, argument, G_TYPE_NONE);
+        g_object_unref(result);
+    }
+    g_object_unref(callback);
+}
+
+void on_remote_reply(GObject* source, GAsyncResult* result, gpointer user_data) {
+    auto* reply = static_cast<RemoteReply*>(user_data);
+    GError* error = nullptr;
+    WebKitUserMessage* message = webkit_web_page_send_message_to_view_finish(WEBKIT_WEB_PAGE(source), result, &error);
+
+    std::string content;
+    if (message) {
+        GVariant* params = webkit_user_message_get_parameters(message);
+        if (params && g_variant_is_of_type(params, G_VARIANT_TYPE_STRING)) content = g_variant_get_string(params, nullptr);
+        g_object_unref(message);
+    } else {
+        g_print("[SNS Guardian Extension] Remote request %d failed: %s\n", reply->id, error ? error->message : "unknown");
+        g_clear_error(&error);
+    }
+
+    JSCValue* callback = jsc_context_get_value(reply->context, "guardianRemoteCallback");
+    if (jsc_value_is_function(callback)) {
+        JSCValue* ret = jsc_value_function_call(callback, G_TYPE_INT, reply->id, G_TYPE_STRING, content.c_str(), G_TYPE_NONE);
+        g_object_unref(ret);
+    }
+    g_object_unref(callback);
+    g_object_unref(reply->context);
+    delete reply;
+}
+
+// sgNative.post(name, message): 注入スクリプト版の messageHandlers[name].postMessage(message) に相当
+void bridge_post(const char* name, JSCValue* message, gpointer user_data) {
+    auto* page = WEBKIT_WEB_PAGE(user_data);
+    JSCContext* context = jsc_value_get_context(message);
+
+    if (g_strcmp0(name, "guardianBatch") == 0) {
+        gint64 started = g_get_monotonic_time();
+        auto posts = posts_from_jsc(message);
+        JSCValue* results = jsc_value_new_from_json(context, score_posts_json(posts).c_str());
+        call_page_callback(context, "guardianBatchCallback", results);
+        g_object_unref(results);
+        g_print("[SNS Guardian Extension] Scored %zu posts in-process in %" G_GINT64_FORMAT " us\n", posts.size(), g_get_monotonic_time() - started);
+        return;
+    }
+
+    if (g_strcmp0(name, "cancelRemote") == 0) {
+        if (!jsc_value_is_number(message)) return;
+        webkit_web_page_send_message_to_view(page,
+            webkit_user_message_new("guardian-cancel", g_variant_new_int32(jsc_value_to_int32(message))),
+            nullptr, nullptr, nullptr);
+        return;
+    }
+
+    if (g_strcmp0(name, "gemini") == 0 || g_strcmp0(name, "rest") == 0) {
+        if (!jsc_value_is_object(message)) return;
+        int id = jsc_int_property(message, "id");
+        GVariant* params = g_variant_new("(sisss)", name, id,
+            jsc_string_property(message, "text").c_str(),
+            jsc_string_property(message, "replyTo").c_str(),
+            jsc_string_property(message, "platform").c_str());
+
+        auto* reply = new RemoteReply{JSC_CONTEXT(g_object_ref(context)), id};
+        webkit_web_page_send_message_to_view(page, webkit_user_message_new("guardian-remote", params), nullptr, on_remote_reply, reply);
+    }
+}
+
+void on_window_object_cleared(WebKitScriptWorld* world, WebKitWebPage* page, WebKitFrame* frame, gpointer) {
+    if (!webkit_frame_is_main_frame(frame)) return;
+
+    JSCContext* context = webkit_frame_get_js_context_for_script_world(frame, world);
+    JSCValue* bridge = jsc_value_new_object(context, nullptr, nullptr);
+    JSCValue* kind = jsc_value_new_string(context, "extension");
+    JSCValue* has = jsc_value_new_function(context, "has", G_CALLBACK(bridge_has), nullptr, nullptr, G_TYPE_BOOLEAN, 1, G_TYPE_STRING);
+    JSCValue* post = jsc_value_new_function(context, "post", G_CALLBACK(bridge_post), page, nullptr, G_TYPE_NONE, 2, G_TYPE_STRING, JSC_TYPE_VALUE);
+
+    jsc_value_object_set_property(bridge, "kind", kind);
+    jsc_value_object_set_property(bridge, "has", has);
+    jsc_value_object_set_property(bridge, "post", post);
+    jsc_context_set_value(context, "sgNative", bridge);
+
+    g_object_unref(post);
+    g_object_unref(has);
+    g_object_unref(kind);
+    g_object_unref(bridge);
+    g_object_unref(context);
+}
+
+void on_document_loaded(WebKitWebPage* page, gpointer) {
+    gint64 started = g_get_monotonic_time();
+    JSCContext* context = webkit_frame_get_js_context_for_script_world(webkit_web_page_get_main_frame(page), extension_state.world);
+
+    std::string script = build_guardian_script(extension_state.settings);
+    JSCValue* result = jsc_context_evaluate(context, script.c_str(), -1);
+    if (JSCException* exception = jsc_context_get_exception(context)) {
+        g_print("[SNS Guardian Extension] Script error: %s\n", jsc_exception_get_message(exception));
+        jsc_context_clear_exception(context);
+    }
+    g_object_unref(result);
+    g_object_unref(context);
+
+    g_print("[SNS Guardian Extension] Guardian started on %s in %" G_GINT64_FORMAT " us\n", webkit_web_page_get_uri(page), g_get_monotonic_time() - started);
+}
+
+} // namespace
+
+extern "C" G_MODULE_EXPORT void webkit_web_extension_initialize_with_user_data(WebKitWebExtension* extension, const GVariant* user_data) {
+    extension_state.settings = settings_from_variant(const_cast<GVariant*>(user_data));
+    extension_state.world = webkit_script_world_new_with_name("sns-guardian");
+    g_print("[SNS Guardian Extension] Initialized, provider: %s\n", provider_to_string(extension_state.settings.provider).c_str());
+
+    g_signal_connect(extension_state.world, "window-object-cleared", G_CALLBACK(on_window_object_cleared), nullptr);
+
+    g_signal_connect(extension, "page-created", G_CALLBACK(+[](WebKitWebExtension*, WebKitWebPage* page, gpointer) {
+        g_signal_connect(page, "document-loaded", G_CALLBACK(on_document_loaded), nullptr);
+    }), nullptr);
+
+    // 設定画面で「設定を適用」したときに UI プロセスから届く
+    g_signal_connect(extension, "user-message-received", G_CALLBACK(+[](WebKitWebExtension*, WebKitUserMessage* message, gpointer) -> gboolean {
+        if (g_strcmp0(webkit_user_message_get_name(message), "guardian-settings") != 0) return FALSE;
+        extension_state.settings = settings_from_variant(webkit_user_message_get_parameters(message));
+        g_print("[SNS Guardian Extension] Settings updated, provider: %s\n", provider_to_string(extension_state.settings.provider).c_str());
+        return TRUE;
+    }), nullptr);
+}
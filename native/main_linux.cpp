@@ -1,32 +1,54 @@
 #include <gtk/gtk.h>
 #include <webkit2/webkit2.h>
+#include <json-glib/json-glib.h>
+#include "guardian_core.h"
 #include <string>
-#include <sstream>
 #include <cctype>
 #include <cstdlib>
 #include <algorithm>
 #include <curl/curl.h>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#ifndef SNS_GUARDIAN_EXTENSION_DIR
+#define SNS_GUARDIAN_EXTENSION_DIR "extension"
+#endif
+
+using namespace sns_guardian;
 
 namespace {
 
-enum class AnalysisProvider {
-    Api,
-    Gemini,
-    LocalHeuristic
-};
+constexpr glong kGeminiMaxInputChars = 600;
+constexpr glong kGeminiMaxReplyContextChars = 280;
+constexpr gint64 kGeminiMaxOutputTokens = 256;
+// 思考を無効にできないモデルでは思考トークンも上限に含まれるため、その分を上乗せする
+constexpr gint64 kGeminiThinkingMaxOutputTokens = 2048;
+constexpr gint64 kGeminiMaxListItems = 3;
+
+// --trace-startup で起動フェーズの時刻を Chrome trace 形式 (chrome://tracing / Perfetto) で書き出す
+struct StartupTrace {
+    struct Event {
+        std::string name;
+        gint64 start = 0;
+        gint64 end = 0;
+    };
 
-struct GuardianSettings {
-    std::string api_url = "http://localhost:8000/api/v1";
-    std::string gemini_api_key{};
-    std::string gemini_model = "gemini-2.5-flash-lite-preview-09-2025";
-    AnalysisProvider provider = AnalysisProvider::LocalHeuristic;
-    bool enable_analysis = true;
-    bool enable_pattern = true;
+    bool enabled = false;
+    std::string path = "startup-trace.json";
+    gint64 origin = 0;
+    std::vector<Event> events;
+    bool load_committed = false;
+    bool load_finished = false;
+    gulong paint_handler = 0;
 };
 
 struct AppState {
+    StartupTrace trace{};
     GtkWidget* window = nullptr;
     GtkWidget* web_view = nullptr;
     GtkWidget* api_entry = nullptr;
@@ -35,41 +57,76 @@ struct AppState {
     GtkWidget* gemini_model_entry = nullptr;
     GtkWidget* toggle_analysis = nullptr;
     GtkWidget* toggle_pattern = nullptr;
+    GtkWidget* toggle_annotate = nullptr;
+    GtkWidget* deadline_spin = nullptr;
     GtkWidget* notebook = nullptr;
+    // 設定タブは初めて開かれたときに build_settings_page() で中身を作る
+    GtkWidget* settings_page = nullptr;
+    bool settings_built = false;
+    WebKitWebContext* web_context = nullptr;
     GuardianSettings settings{};
+    // Gemini の API キーは UI プロセスだけが持つ（settings.gemini_configured で有無だけを共有する）
+    std::string gemini_api_key;
+    // true のときガーディアンは Web プロセス拡張で動き、ページへのスクリプト注入は行わない
+    bool use_web_extension = false;
+    // 実行中のリモート分析（ページ側のリクエストID → 中止フラグ）
+    std::mutex remote_mutex;
+    std::map<int, std::shared_ptr<std::atomic<bool>>> remote_requests;
 };
 
-std::string js_escape(const std::string& input) {
-    std::string out;
-    out.reserve(input.size());
-    for (char c : input) {
-        switch (c) {
-        case '\\': out += "\\\\"; break;
-        case '\'': out += "\\'"; break;
-        case '`': out += "\\`"; break;
-        case '\n': out += "\\n"; break;
-        case '\r': out += "\\r"; break;
-        case '\t': out += "\\t"; break;
-        default: out.push_back(c); break;
-        }
-    }
-    return out;
+void trace_phase(StartupTrace& trace, const char* name, gint64 start) {
+    if (!trace.enabled) return;
+    trace.events.push_back({name, start, g_get_monotonic_time()});
 }
 
-std::string provider_to_string(AnalysisProvider provider) {
-    switch (provider) {
-    case AnalysisProvider::Gemini: return "gemini";
-    case AnalysisProvider::LocalHeuristic: return "local";
-    default: return "api";
-    }
+// 時刻は一度だけ読む（start == end で instant イベントとして書き出される）
+void trace_mark(StartupTrace& trace, const char* name) {
+    if (!trace.enabled) return;
+    gint64 now = g_get_monotonic_time();
+    trace.events.push_back({name, now, now});
 }
 
-AnalysisProvider string_to_provider(const std::string& value) {
-    std::string lower = value;
-    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-    if (lower == "gemini") return AnalysisProvider::Gemini;
-    if (lower == "local" || lower == "heuristic") return AnalysisProvider::LocalHeuristic;
-    return AnalysisProvider::Api;
+void trace_write(const StartupTrace& trace) {
+    if (!trace.enabled) return;
+
+    JsonBuilder* builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "traceEvents");
+    json_builder_begin_array(builder);
+    for (const auto& event : trace.events) {
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "name");
+        json_builder_add_string_value(builder, event.name.c_str());
+        json_builder_set_member_name(builder, "cat");
+        json_builder_add_string_value(builder, "startup");
+        json_builder_set_member_name(builder, "ph");
+        json_builder_add_string_value(builder, event.end > event.start ? "X" : "i");
+        json_builder_set_member_name(builder, "ts");
+        json_builder_add_int_value(builder, event.start - trace.origin);
+        if (event.end > event.start) {
+            json_builder_set_member_name(builder, "dur");
+            json_builder_add_int_value(builder, event.end - event.start);
+        } else {
+            json_builder_set_member_name(builder, "s");
+            json_builder_add_string_value(builder, "g");
+        }
+        json_builder_set_member_name(builder, "pid");
+        json_builder_add_int_value(builder, 1);
+        json_builder_set_member_name(builder, "tid");
+        json_builder_add_int_value(builder, 1);
+        json_builder_end_object(builder);
+    }
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    std::string json = json_builder_to_string(builder, true);
+    GError* error = nullptr;
+    if (g_file_set_contents(trace.path.c_str(), json.c_str(), static_cast<gssize>(json.length()), &error)) {
+        g_print("[SNS Guardian] Startup trace written: %s\n", trace.path.c_str());
+    } else {
+        g_print("[SNS Guardian] Failed to write startup trace: %s\n", error->message);
+        g_clear_error(&error);
+    }
 }
 
 bool parse_bool_env(const char* value, bool fallback) {
@@ -87,8 +144,9 @@ GuardianSettings load_settings_from_env() {
     if (const char* provider = std::getenv("SNS_GUARDIAN_PROVIDER")) settings.provider = string_to_provider(provider);
     settings.enable_analysis = parse_bool_env(std::getenv("SNS_GUARDIAN_ENABLE_ANALYSIS"), settings.enable_analysis);
     settings.enable_pattern = parse_bool_env(std::getenv("SNS_GUARDIAN_ENABLE_PATTERN"), settings.enable_pattern);
-    if (const char* key = std::getenv("SNS_GUARDIAN_GEMINI_API_KEY")) settings.gemini_api_key = key;
+    settings.annotate_timeline = parse_bool_env(std::getenv("SNS_GUARDIAN_ANNOTATE_TIMELINE"), settings.annotate_timeline);
     if (const char* model = std::getenv("SNS_GUARDIAN_GEMINI_MODEL")) settings.gemini_model = model;
+    if (const char* deadline = std::getenv("SNS_GUARDIAN_DEADLINE_MS")) settings.deadline_ms = std::clamp(std::atoi(deadline), 100, 15000);
     return settings;
 }
 
@@ -98,23 +156,160 @@ size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* use
     return total_size;
 }
 
-std::string perform_gemini_request(const std::string& api_key, const std::string& model, const std::string& text) {
+std::string truncate_utf8(const std::string& text, glong max_chars) {
+    if (g_utf8_strlen(text.c_str(), -1) <= max_chars) return text;
+    const char* end = g_utf8_offset_to_pointer(text.c_str(), max_chars);
+    return std::string(text.c_str(), end) + "…";
+}
+
+void add_string_list_schema(JsonBuilder* builder, const char* name) {
+    json_builder_set_member_name(builder, name);
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "ARRAY");
+    json_builder_set_member_name(builder, "maxItems");
+    json_builder_add_int_value(builder, kGeminiMaxListItems);
+    json_builder_set_member_name(builder, "items");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "STRING");
+    json_builder_end_object(builder);
+    json_builder_end_object(builder);
+}
+
+enum class GeminiThinking { None, Disable, Required };
+
+// 1.x / 2.0 は思考なし、2.5 Flash 系は thinkingBudget: 0 で無効化できる。それ以外（2.5 Pro 以降）は無効化できないものとして扱う
+GeminiThinking gemini_thinking_for(const std::string& model) {
+    if (model.rfind("gemini-1.", 0) == 0 || model.rfind("gemini-2.0", 0) == 0) return GeminiThinking::None;
+    if (model.rfind("gemini-2.5-flash", 0) == 0) return GeminiThinking::Disable;
+    return GeminiThinking::Required;
+}
+
+// 入力長を制限し、返信先は返信時のみ添付し、出力をスキーマとトークン上限で絞る
+std::string build_gemini_payload(const std::string& model, const std::string& text, const std::string& reply_context) {
+    GeminiThinking thinking = gemini_thinking_for(model);
+
+    std::string prompt = "SNS投稿の炎上リスクを判定してください。risk_factors と suggestions は各3件以内の短い日本語で。\n投稿: ";
+    prompt += truncate_utf8(text, kGeminiMaxInputChars);
+    if (!reply_context.empty() && reply_context != text) {
+        prompt += "\n返信先: ";
+        prompt += truncate_utf8(reply_context, kGeminiMaxReplyContextChars);
+    }
+
+    JsonBuilder* builder = json_builder_new();
+    json_builder_begin_object(builder);
+
+    json_builder_set_member_name(builder, "contents");
+    json_builder_begin_array(builder);
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "parts");
+    json_builder_begin_array(builder);
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "text");
+    json_builder_add_string_value(builder, prompt.c_str());
+    json_builder_end_object(builder);
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+    json_builder_end_array(builder);
+
+    json_builder_set_member_name(builder, "generationConfig");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "temperature");
+    json_builder_add_double_value(builder, 0.0);
+    json_builder_set_member_name(builder, "maxOutputTokens");
+    json_builder_add_int_value(builder, thinking == GeminiThinking::Required ? kGeminiThinkingMaxOutputTokens : kGeminiMaxOutputTokens);
+    if (thinking == GeminiThinking::Disable) {
+        json_builder_set_member_name(builder, "thinkingConfig");
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "thinkingBudget");
+        json_builder_add_int_value(builder, 0);
+        json_builder_end_object(builder);
+    }
+    json_builder_set_member_name(builder, "responseMimeType");
+    json_builder_add_string_value(builder, "application/json");
+
+    json_builder_set_member_name(builder, "responseSchema");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "OBJECT");
+    json_builder_set_member_name(builder, "properties");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "risk_level");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "STRING");
+    json_builder_set_member_name(builder, "enum");
+    json_builder_begin_array(builder);
+    json_builder_add_string_value(builder, "low");
+    json_builder_add_string_value(builder, "medium");
+    json_builder_add_string_value(builder, "high");
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+    json_builder_set_member_name(builder, "risk_score");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "NUMBER");
+    json_builder_end_object(builder);
+    add_string_list_schema(builder, "risk_factors");
+    add_string_list_schema(builder, "suggestions");
+    json_builder_end_object(builder);
+    json_builder_set_member_name(builder, "required");
+    json_builder_begin_array(builder);
+    json_builder_add_string_value(builder, "risk_level");
+    json_builder_add_string_value(builder, "risk_score");
+    json_builder_add_string_value(builder, "risk_factors");
+    json_builder_add_string_value(builder, "suggestions");
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    json_builder_end_object(builder);
+    json_builder_end_object(builder);
+
+    return json_builder_to_string(builder);
+}
+
+// API のエラー応答と同じ {"error": {"message": ...}} の形で返し、ページ側で理由を表示できるようにする
+std::string error_json(const std::string& message) {
+    JsonBuilder* builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "error");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "message");
+    json_builder_add_string_value(builder, message.c_str());
+    json_builder_end_object(builder);
+    json_builder_end_object(builder);
+
+    return json_builder_to_string(builder);
+}
+
+bool has_error_object(const std::string& json) {
+    JsonParser* parser = json_parser_new();
+    bool result = false;
+    if (json_parser_load_from_data(parser, json.c_str(), static_cast<gssize>(json.length()), nullptr)) {
+        JsonNode* root = json_parser_get_root(parser);
+        JsonObject* object = (root && JSON_NODE_HOLDS_OBJECT(root)) ? json_node_get_object(root) : nullptr;
+        JsonNode* error = object ? json_object_get_member(object, "error") : nullptr;
+        result = error && JSON_NODE_HOLDS_OBJECT(error);
+    }
+    g_object_unref(parser);
+    return result;
+}
+
+int CancelCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    auto* cancelled = static_cast<const std::atomic<bool>*>(clientp);
+    return (cancelled && cancelled->load()) ? 1 : 0;
+}
+
+// JSON を POST する。cancelled が立つと転送を中断する
+std::string perform_json_post(const std::string& url, const std::string& payload, long timeout_seconds, const std::atomic<bool>* cancelled) {
     CURL* curl;
     CURLcode res;
     std::string readBuffer;
-    
-    g_print("[SNS Guardian C++] perform_gemini_request called\n");
-    g_print("[SNS Guardian C++] Model: %s\n", model.c_str());
-    g_print("[SNS Guardian C++] API Key length: %zu\n", api_key.length());
 
     curl = curl_easy_init();
     if(curl) {
-        std::string url = "https://generativelanguage.googleapis.com/v1beta/models/" + model + ":generateContent?key=" + api_key;
-        
-        std::string escaped_text = js_escape(text);
-        std::string payload = R"({"contents":[{"parts":[{"text":"SNS投稿のリスク分析をしてください。JSONのみを返してください。形式: {\"risk_level\":\"low|medium|high\",\"risk_score\":0-1,\"risk_factors\":[\"...\"],\"suggestions\":[\"...\"]}. 投稿文: )" + escaped_text + R"("}]}],"generationConfig":{"responseMimeType":"application/json"}})";
-
-        g_print("[SNS Guardian C++] URL: %s\n", url.substr(0, 80).c_str());
+        g_print("[SNS Guardian C++] Payload bytes: %zu\n", payload.length());
 
         struct curl_slist *headers = NULL;
         headers = curl_slist_append(headers, "Content-Type: application/json");
@@ -122,19 +317,33 @@ std::string perform_gemini_request(const std::string& api_key, const std::string
         curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
         curl_easy_setopt(curl, CURLOPT_POST, 1L);
         curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(payload.length()));
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout_seconds);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, const_cast<std::atomic<bool>*>(cancelled));
 
+        gint64 started = g_get_monotonic_time();
         res = curl_easy_perform(curl);
+        gint64 elapsed_ms = (g_get_monotonic_time() - started) / 1000;
         
-        if(res != CURLE_OK) {
+        long status = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+
+        if(res == CURLE_ABORTED_BY_CALLBACK) {
+            g_print("[SNS Guardian C++] Request cancelled after %" G_GINT64_FORMAT " ms\n", elapsed_ms);
+            readBuffer.clear();
+        } else if(res != CURLE_OK) {
             g_print("[SNS Guardian C++] CURL error: %s\n", curl_easy_strerror(res));
-            readBuffer = "{\"error\": \"CURL error: " + std::string(curl_easy_strerror(res)) + "\"}";
+            readBuffer = error_json(std::string("CURL error: ") + curl_easy_strerror(res));
         } else {
-            g_print("[SNS Guardian C++] Response received, length: %zu\n", readBuffer.length());
+            g_print("[SNS Guardian C++] Response received, status: %ld, length: %zu, %" G_GINT64_FORMAT " ms\n", status, readBuffer.length(), elapsed_ms);
+            // HTML のエラーページや {"detail": ...} を分析結果として渡さない（Gemini の {"error": {...}} はそのまま返す）
+            if(status >= 400 && !has_error_object(readBuffer)) readBuffer = error_json("HTTP " + std::to_string(status));
         }
         
         curl_easy_cleanup(curl);
@@ -143,37 +352,165 @@ std::string perform_gemini_request(const std::string& api_key, const std::string
     return readBuffer;
 }
 
+std::string perform_gemini_request(const std::string& api_key, const std::string& model, const std::string& text, const std::string& reply_context, const std::atomic<bool>* cancelled) {
+    g_print("[SNS Guardian C++] perform_gemini_request called\n");
+    g_print("[SNS Guardian C++] Model: %s, prompt: %s\n", model.c_str(), kGeminiPromptVersion);
+    g_print("[SNS Guardian C++] API Key length: %zu\n", api_key.length());
+
+    std::string url = "https://generativelanguage.googleapis.com/v1beta/models/" + model + ":generateContent?key=" + api_key;
+    g_print("[SNS Guardian C++] URL: %s\n", url.substr(0, 80).c_str());
+    return perform_json_post(url, build_gemini_payload(model, text, reply_context), 30L, cancelled);
+}
+
+// REST API (POST {api_url}/analysis/tweet) はリスク分析の JSON をそのまま返す
+std::string perform_rest_request(const std::string& api_url, const std::string& text, const std::string& reply_context, const std::string& platform, const std::atomic<bool>* cancelled) {
+    g_print("[SNS Guardian C++] perform_rest_request called\n");
+
+    std::string url = api_url;
+    while (!url.empty() && url.back() == '/') url.pop_back();
+    url += "/analysis/tweet";
+
+    JsonBuilder* builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "text");
+    json_builder_add_string_value(builder, text.c_str());
+    json_builder_set_member_name(builder, "platform");
+    json_builder_add_string_value(builder, platform.c_str());
+    if (!reply_context.empty()) {
+        json_builder_set_member_name(builder, "replying_to");
+        json_builder_add_string_value(builder, reply_context.c_str());
+    }
+    json_builder_end_object(builder);
+
+    std::string payload = json_builder_to_string(builder);
+
+    g_print("[SNS Guardian C++] URL: %s\n", url.c_str());
+    return perform_json_post(url, payload, 15L, cancelled);
+}
+
 std::string extract_gemini_text(const std::string& json) {
-    std::string key = "\"text\":";
-    size_t pos = json.find(key);
-    if (pos == std::string::npos) return "";
-    pos += key.length();
-    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '"')) pos++;
-    if (pos >= json.length()) return "";
-    pos--; // back to quote
-    if (json[pos] != '"') return "";
-    pos++;
-    
+    JsonParser* parser = json_parser_new();
     std::string result;
-    bool escaped = false;
-    for (size_t i = pos; i < json.length(); ++i) {
-        char c = json[i];
-        if (escaped) {
-            if (c == '"') result += '"';
-            else if (c == '\\') result += '\\';
-            else if (c == 'n') result += '\n';
-            else result += c;
-            escaped = false;
-        } else {
-            if (c == '\\') escaped = true;
-            else if (c == '"') break;
-            else result += c;
+    if (json_parser_load_from_data(parser, json.c_str(), static_cast<gssize>(json.length()), nullptr)) {
+        JsonNode* root = json_parser_get_root(parser);
+        JsonObject* object = (root && JSON_NODE_HOLDS_OBJECT(root)) ? json_node_get_object(root) : nullptr;
+
+        if (object && json_object_has_member(object, "usageMetadata")) {
+            JsonObject* usage = json_object_get_object_member(object, "usageMetadata");
+            g_print("[SNS Guardian C++] Tokens: prompt=%" G_GINT64_FORMAT " output=%" G_GINT64_FORMAT "\n",
+                json_object_get_int_member_with_default(usage, "promptTokenCount", 0),
+                json_object_get_int_member_with_default(usage, "candidatesTokenCount", 0));
+        }
+
+        JsonArray* candidates = object && json_object_has_member(object, "candidates") ? json_object_get_array_member(object, "candidates") : nullptr;
+        if (candidates && json_array_get_length(candidates) > 0) {
+            JsonObject* candidate = json_array_get_object_element(candidates, 0);
+            JsonObject* content = json_object_has_member(candidate, "content") ? json_object_get_object_member(candidate, "content") : nullptr;
+            JsonArray* parts = content && json_object_has_member(content, "parts") ? json_object_get_array_member(content, "parts") : nullptr;
+            if (parts && json_array_get_length(parts) > 0) {
+                const char* text = json_object_get_string_member_with_default(json_array_get_object_element(parts, 0), "text", "");
+                result = text;
+            }
         }
     }
+    g_object_unref(parser);
     g_print("[SNS Guardian C++] Extracted text: %s\n", result.substr(0, 100).c_str());
     return result;
 }
 
+using RemoteFetch = std::function<std::string(const std::atomic<bool>*)>;
+using RemoteDeliver = std::function<void(const std::string&)>;
+
+// handler ("gemini" / "rest") に応じたリモート分析を、現在の設定のコピーで組み立てる
+RemoteFetch make_remote_fetch(AppState* st, const std::string& handler, const std::string& text, const std::string& reply_context, const std::string& platform) {
+    if (handler == "gemini") {
+        std::string api_key = st->gemini_api_key;
+        std::string model = st->settings.gemini_model;
+        return [text, reply_context, api_key, model](const std::atomic<bool>* cancelled) {
+            std::string result_json = perform_gemini_request(api_key, model, text, reply_context, cancelled);
+            std::string content = extract_gemini_text(result_json);
+            return content.empty() ? result_json : content;
+        };
+    }
+    std::string api_url = st->settings.api_url;
+    return [text, reply_context, platform, api_url](const std::atomic<bool>* cancelled) {
+        return perform_rest_request(api_url, text, reply_context, platform, cancelled);
+    };
+}
+
+// fetch をワーカースレッドで実行し、結果をメインスレッドで deliver に渡す（中止時は空文字列）
+void start_remote_analysis(AppState* st, int id, RemoteFetch fetch, RemoteDeliver deliver) {
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    {
+        std::lock_guard<std::mutex> lock(st->remote_mutex);
+        st->remote_requests[id] = cancelled;
+    }
+
+    std::thread([st, id, cancelled, fetch = std::move(fetch), deliver = std::move(deliver)]() {
+        std::string content = fetch(cancelled.get());
+        {
+            std::lock_guard<std::mutex> lock(st->remote_mutex);
+            auto it = st->remote_requests.find(id);
+            if (it != st->remote_requests.end() && it->second == cancelled) st->remote_requests.erase(it);
+        }
+        if (cancelled->load()) content.clear();
+
+        g_idle_add(+[](gpointer user_data) -> gboolean {
+            auto* params = static_cast<std::pair<RemoteDeliver, std::string>*>(user_data);
+            params->first(params->second);
+            delete params;
+            return FALSE;
+        }, new std::pair<RemoteDeliver, std::string>(deliver, content));
+    }).detach();
+}
+
+void cancel_remote_analysis(AppState* st, int id) {
+    std::lock_guard<std::mutex> lock(st->remote_mutex);
+    auto it = st->remote_requests.find(id);
+    if (it != st->remote_requests.end()) {
+        g_print("[SNS Guardian C++] Cancelling remote request %d\n", id);
+        it->second->store(true);
+    }
+}
+
+// 注入スクリプト経由のリクエストは window.guardianRemoteCallback(id, json) で返す
+RemoteDeliver deliver_to_page(AppState* st, int id) {
+    return [st, id](const std::string& content) {
+        std::string callback_js = "if(window.guardianRemoteCallback) window.guardianRemoteCallback(" + std::to_string(id) + ", '" + js_escape(content) + "');";
+        webkit_web_view_evaluate_javascript(WEBKIT_WEB_VIEW(st->web_view), callback_js.c_str(), -1, nullptr, nullptr, nullptr, nullptr, nullptr);
+    };
+}
+
+// Web プロセス拡張からのリモート分析・中止要求
+gboolean on_user_message_received(WebKitWebView*, WebKitUserMessage* message, gpointer user_data) {
+    auto* st = static_cast<AppState*>(user_data);
+    const char* name = webkit_user_message_get_name(message);
+    GVariant* params = webkit_user_message_get_parameters(message);
+
+    if (g_strcmp0(name, "guardian-remote") == 0 && params && g_variant_is_of_type(params, G_VARIANT_TYPE("(sisss)"))) {
+        const char* handler = nullptr;
+        int id = 0;
+        const char* text = nullptr;
+        const char* reply_context = nullptr;
+        const char* platform = nullptr;
+        g_variant_get(params, "(&si&s&s&s)", &handler, &id, &text, &reply_context, &platform);
+        g_print("[SNS Guardian C++] Received %s request %d from web extension, length: %zu\n", handler, id, strlen(text));
+
+        g_object_ref(message);
+        start_remote_analysis(st, id, make_remote_fetch(st, handler, text, reply_context, platform), [message](const std::string& content) {
+            webkit_user_message_send_reply(message, webkit_user_message_new("guardian-remote-result", g_variant_new_string(content.c_str())));
+            g_object_unref(message);
+        });
+        return TRUE;
+    }
+
+    if (g_strcmp0(name, "guardian-cancel") == 0 && params && g_variant_is_of_type(params, G_VARIANT_TYPE_INT32)) {
+        cancel_remote_analysis(st, g_variant_get_int32(params));
+        return TRUE;
+    }
+    return FALSE;
+}
+
 std::string normalize_url(const std::string& input) {
     std::string trimmed = input;
     while (!trimmed.empty() && isspace(static_cast<unsigned char>(trimmed.front()))) trimmed.erase(trimmed.begin());
@@ -189,279 +526,287 @@ void navigate_to(AppState* state, const std::string& url) {
 }
 
 void on_load_changed(WebKitWebView* web_view, WebKitLoadEvent load_event, gpointer user_data) {
+    if (load_event == WEBKIT_LOAD_COMMITTED) {
+        auto* state = static_cast<AppState*>(user_data);
+        if (state->trace.enabled && !state->trace.load_committed) {
+            state->trace.load_committed = true;
+            trace_mark(state->trace, "load_committed");
+        }
+    }
     if (load_event == WEBKIT_LOAD_FINISHED) {
         auto* state = static_cast<AppState*>(user_data);
+        if (state->trace.enabled && !state->trace.load_finished) {
+            state->trace.load_finished = true;
+            trace_mark(state->trace, "load_finished");
+            trace_write(state->trace);
+        }
         
         g_print("\n[SNS Guardian] === Page Load Complete ===\n");
         g_print("[SNS Guardian] Provider: %s\n", provider_to_string(state->settings.provider).c_str());
-        g_print("[SNS Guardian] API Key set: %s\n", state->settings.gemini_api_key.empty() ? "NO" : "YES");
+        g_print("[SNS Guardian] API Key set: %s\n", state->gemini_api_key.empty() ? "NO" : "YES");
         g_print("[SNS Guardian] Model: %s\n", state->settings.gemini_model.c_str());
         g_print("[SNS Guardian] Enable Analysis: %s\n", state->settings.enable_analysis ? "true" : "false");
         
-        std::ostringstream script;
-        script << R"JS(
-(function() {
-    console.log('[SNS Guardian] Script starting...');
-    
-    var settings = {
-        apiUrl: ')JS" << js_escape(state->settings.api_url) << R"JS(',
-        provider: ')JS" << provider_to_string(state->settings.provider) << R"JS(',
-        geminiApiKey: ')JS" << js_escape(state->settings.gemini_api_key) << R"JS(',
-        geminiModel: ')JS" << js_escape(state->settings.gemini_model) << R"JS(',
-        enableAnalysis: )JS" << (state->settings.enable_analysis ? "true" : "false") << R"JS(,
-        enablePattern: )JS" << (state->settings.enable_pattern ? "true" : "false") << R"JS(
-    };
-    
-    console.log('[SNS Guardian] Settings loaded:', settings.provider, 'apiKey:', settings.geminiApiKey ? 'SET' : 'NOT SET');
-    
-    var h = location.hostname;
-    var platform = null;
-    if(h.includes('twitter.com') || h.includes('x.com')) platform = 'x';
-    else if(h.includes('mastodon')) platform = 'mastodon';
-    else if(h.includes('bsky.app')) platform = 'bluesky';
-    
-    console.log('[SNS Guardian] Platform:', platform);
-    if(!platform) return;
-    
-    var sensitiveWords = ['kill', '死ね', 'バカ', '最低', '馬鹿', 'ばか', 'stupid', 'idiot'];
-    
-    function localAnalysis(text) {
-        console.log('[SNS Guardian] Local analysis...');
-        var score = 0.08;
-        var factors = [];
-        var lower = text.toLowerCase();
-        
-        if(text.length > 240) { score += 0.12; factors.push('長文は誤解されやすい'); }
-        if(/!{2,}/.test(text) || /[A-Z]{6,}/.test(text)) { score += 0.12; factors.push('強い表現が含まれています'); }
-        
-        for(var i = 0; i < sensitiveWords.length; i++) {
-            if(lower.includes(sensitiveWords[i].toLowerCase())) {
-                score += 0.2;
-                factors.push('攻撃的な単語を検知');
-                break;
-            }
+        if (state->use_web_extension) {
+            g_print("[SNS Guardian] Guardian runs in the web extension, skipping script injection\n");
+            return;
         }
         
-        if(text.includes('http')) { score += 0.05; factors.push('リンク共有'); }
+        std::string script = build_guardian_script(state->settings);
         
-        score = Math.min(score, 0.95);
-        var level = score > 0.45 ? 'high' : score > 0.25 ? 'medium' : 'low';
-        
-        return { level: level, score: score, factors: factors };
+        webkit_web_view_evaluate_javascript(
+            WEBKIT_WEB_VIEW(state->web_view),
+            script.c_str(),
+            -1, nullptr, nullptr, nullptr, nullptr, nullptr
+        );
     }
+}
+
+void build_settings_page(AppState* state) {
+    gint64 phase_start = g_get_monotonic_time();
+    state->settings_built = true;
+
+    GtkCssProvider* css_provider = gtk_css_provider_new();
+    const char* css = R"CSS(
+        .settings-page { background-color: #0a0a0f; padding: 16px; }
+        .settings-card { background-color: #12121a; border: 2px solid #00fff2; border-radius: 12px; padding: 16px; margin: 6px 0; }
+        .section-title { color: #00fff2; font-size: 15px; font-weight: bold; }
+        .settings-page entry { background-color: #1a1a2e; background-image: none; border: 2px solid #4a4a6a; border-radius: 6px; padding: 8px; color: #ffffff; min-height: 16px; }
+        .settings-page entry:focus { border-color: #ff00ff; }
+        .settings-page combobox, .settings-page combobox * { background-color: #1a1a2e; color: #ffffff; }
+        .settings-page combobox button { background-color: #1a1a2e; background-image: none; border: 2px solid #4a4a6a; border-radius: 6px; color: #ffffff; }
+        .settings-page combobox button:hover { border-color: #00fff2; background-color: #2a2a4a; }
+        .settings-page combobox cellview { background-color: transparent; color: #ffffff; }
+        .settings-page checkbutton { color: #ddddee; }
+        .settings-page checkbutton check { background-color: #1a1a2e; background-image: none; border: 2px solid #4a4a6a; border-radius: 4px; }
+        .settings-page checkbutton:checked check { background-color: #ff00ff; border-color: #ff00ff; }
+        .apply-button { background-image: linear-gradient(135deg, #ff00ff, #00fff2); background-color: #ff00ff; border: none; border-radius: 8px; padding: 12px 28px; color: #ffffff; font-weight: bold; min-height: 40px; }
+        .apply-button:hover { background-image: linear-gradient(135deg, #ff44ff, #44ffff); }
+    )CSS";
+    gtk_css_provider_load_from_data(css_provider, css, -1, nullptr);
+    gtk_style_context_add_provider_for_screen(gdk_screen_get_default(), GTK_STYLE_PROVIDER(css_provider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+    g_object_unref(css_provider);
+
+    GtkWidget* page = state->settings_page;
     
-    var lastGeminiError = '';
+    GtkWidget* title_label = gtk_label_new("SNS GUARDIAN 設定");
+    gtk_style_context_add_class(gtk_widget_get_style_context(title_label), "section-title");
+    PangoAttrList* title_attrs = pango_attr_list_new();
+    pango_attr_list_insert(title_attrs, pango_attr_scale_new(2.0));
+    pango_attr_list_insert(title_attrs, pango_attr_weight_new(PANGO_WEIGHT_BOLD));
+    gtk_label_set_attributes(GTK_LABEL(title_label), title_attrs);
+    pango_attr_list_unref(title_attrs);
+    gtk_widget_set_halign(title_label, GTK_ALIGN_CENTER);
+    gtk_box_pack_start(GTK_BOX(page), title_label, FALSE, FALSE, 8);
     
-    async function geminiAnalysis(text) {
-        console.log('[SNS Guardian] Starting Gemini analysis...');
-        lastGeminiError = '';
-        
-        if(!settings.geminiApiKey) {
-            lastGeminiError = 'API key not set';
-            console.log('[SNS Guardian] Error:', lastGeminiError);
-            return null;
-        }
-        
-        if (!window.webkit || !window.webkit.messageHandlers || !window.webkit.messageHandlers.gemini) {
-            lastGeminiError = 'Native handler not available';
-            console.log('[SNS Guardian] Error:', lastGeminiError);
-            return null;
-        }
-        
-        console.log('[SNS Guardian] Sending to native handler...');
-        
-        return new Promise(function(resolve) {
-            var timeoutId = setTimeout(function() {
-                lastGeminiError = 'Timeout';
-                console.log('[SNS Guardian] Gemini timeout');
-                resolve(null);
-            }, 15000);
-            
-            window.geminiCallback = function(jsonStr) {
-                console.log('[SNS Guardian] Callback received:', jsonStr ? jsonStr.substring(0, 100) : 'empty');
-                clearTimeout(timeoutId);
-                
-                if(!jsonStr) {
-                    lastGeminiError = 'Empty response';
-                    resolve(null);
-                    return;
-                }
-                
-                try {
-                    var analysis = JSON.parse(jsonStr);
-                    console.log('[SNS Guardian] Parsed analysis:', analysis);
-                    
-                    // APIエラーをチェック（429 quota exceededなど）
-                    if(analysis.error) {
-                        var errCode = analysis.error.code || 'unknown';
-                        var errMsg = analysis.error.message || 'Unknown error';
-                        if(errCode === 429) {
-                            lastGeminiError = 'API quota exceeded (429)';
-                        } else {
-                            lastGeminiError = 'API error ' + errCode + ': ' + errMsg.substring(0, 50);
-                        }
-                        console.log('[SNS Guardian] API error detected:', lastGeminiError);
-                        resolve(null);
-                        return;
-                    }
-                    
-                    resolve(analysis);
-                } catch(e) {
-                    lastGeminiError = 'Parse error';
-                    console.log('[SNS Guardian] Parse error:', e.message, jsonStr.substring(0, 50));
-                    resolve(null);
-                }
-            };
-            
-            try {
-                window.webkit.messageHandlers.gemini.postMessage(text);
-            } catch(e) {
-                clearTimeout(timeoutId);
-                lastGeminiError = 'PostMessage failed';
-                console.log('[SNS Guardian] PostMessage error:', e);
-                resolve(null);
-            }
-        });
-    }
+    GtkWidget* main_card = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
+    gtk_style_context_add_class(gtk_widget_get_style_context(main_card), "settings-card");
     
-    async function analyzeRisk(text) {
-        console.log('[SNS Guardian] analyzeRisk, provider:', settings.provider);
-        var local = localAnalysis(text);
-        var usedProvider = 'local';
-        
-        if(!settings.enableAnalysis || settings.provider === 'local') {
-            local.usedProvider = 'local';
-            return local;
-        }
-        
-        if(settings.provider === 'gemini') {
-            console.log('[SNS Guardian] Calling Gemini...');
-            var advanced = await geminiAnalysis(text);
-            
-            if(advanced && advanced.risk_level) {
-                console.log('[SNS Guardian] Using Gemini result');
-                return {
-                    level: advanced.risk_level,
-                    score: advanced.risk_score || local.score,
-                    factors: (advanced.risk_factors || []).concat(local.factors),
-                    suggestions: advanced.suggestions || [],
-                    usedProvider: 'gemini'
-                };
-            } else {
-                console.log('[SNS Guardian] Gemini failed, using local. Error:', lastGeminiError);
-                local.usedProvider = 'gemini (failed: ' + lastGeminiError + ')';
-            }
-        }
-        
-        return local;
-    }
+    // Provider
+    GtkWidget* provider_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget* provider_label = gtk_label_new("プロバイダ:");
+    gtk_widget_set_size_request(provider_label, 100, -1);
+    state->provider_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(state->provider_combo), "local", "ローカル");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(state->provider_combo), "gemini", "Gemini API");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(state->provider_combo), "api", "REST API");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(state->provider_combo), "hedged", "並列 (期限付き)");
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(state->provider_combo), provider_to_string(state->settings.provider).c_str());
+    gtk_box_pack_start(GTK_BOX(provider_row), provider_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(provider_row), state->provider_combo, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(main_card), provider_row, FALSE, FALSE, 0);
     
-    function showModal(analysis, onContinue, onCancel) {
-        var overlay = document.createElement('div');
-        overlay.style.cssText = 'position:fixed;inset:0;background:rgba(0,0,0,0.6);display:flex;align-items:center;justify-content:center;z-index:2147483647;';
-        
-        var riskColor = analysis.level === 'high' ? '#ef4444' : analysis.level === 'medium' ? '#f59e0b' : '#22c55e';
-        var riskPercent = Math.round(analysis.score * 100);
-        
-        var modal = document.createElement('div');
-        modal.style.cssText = 'background:#fff;border-radius:12px;padding:20px;max-width:400px;width:90%;font-family:sans-serif;';
-        modal.innerHTML = '<h3 style="margin:0 0 16px;color:#0f172a;">送信前チェック</h3>' +
-            '<div style="background:#f1f5f9;padding:12px;border-radius:8px;margin-bottom:12px;">' +
-            '<div style="font-size:14px;color:#64748b;">リスクスコア</div>' +
-            '<div style="font-size:24px;font-weight:bold;color:' + riskColor + ';">' + riskPercent + '% (' + analysis.level + ')</div>' +
-            '<div style="font-size:11px;color:#94a3b8;margin-top:4px;">分析: ' + (analysis.usedProvider || 'unknown') + '</div>' +
-            '</div>' +
-            '<div style="margin-bottom:16px;">' +
-            '<div style="font-size:14px;font-weight:bold;color:#0f172a;margin-bottom:8px;">検出された要因:</div>' +
-            '<ul style="margin:0;padding-left:20px;color:#334155;">' + 
-            (analysis.factors && analysis.factors.length > 0 ? analysis.factors.map(function(f){ return '<li>' + f + '</li>'; }).join('') : '<li>特になし</li>') +
-            '</ul></div>' +
-            '<div style="display:flex;gap:8px;justify-content:flex-end;">' +
-            '<button id="sg-cancel" style="padding:10px 16px;border:1px solid #e2e8f0;background:#fff;border-radius:8px;cursor:pointer;font-weight:bold;">投稿を中止</button>' +
-            '<button id="sg-continue" style="padding:10px 16px;border:none;background:#2563eb;color:#fff;border-radius:8px;cursor:pointer;font-weight:bold;">それでも投稿</button></div>';
-        
-        overlay.appendChild(modal);
-        document.body.appendChild(overlay);
-        
-        modal.querySelector('#sg-cancel').onclick = function() { overlay.remove(); onCancel(); };
-        modal.querySelector('#sg-continue').onclick = function() { overlay.remove(); onContinue(); };
-    }
+    // API URL
+    GtkWidget* api_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget* api_label = gtk_label_new("API URL:");
+    gtk_widget_set_size_request(api_label, 100, -1);
+    state->api_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(state->api_entry), state->settings.api_url.c_str());
+    gtk_box_pack_start(GTK_BOX(api_row), api_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(api_row), state->api_entry, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(main_card), api_row, FALSE, FALSE, 0);
     
-    var buttonSelectors = platform === 'x' ? 
-        'button[data-testid="tweetButtonInline"],button[data-testid="tweetButton"],div[data-testid="tweetButtonInline"],div[data-testid="tweetButton"]' :
-        platform === 'mastodon' ? 'button[type="submit"]' : 'button[data-testid="composer-submit"]';
+    // Gemini API Key
+    GtkWidget* key_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget* key_label = gtk_label_new("API Key:");
+    gtk_widget_set_size_request(key_label, 100, -1);
+    state->gemini_key_entry = gtk_entry_new();
+    gtk_entry_set_visibility(GTK_ENTRY(state->gemini_key_entry), FALSE);
+    gtk_entry_set_text(GTK_ENTRY(state->gemini_key_entry), state->gemini_api_key.c_str());
+    gtk_box_pack_start(GTK_BOX(key_row), key_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(key_row), state->gemini_key_entry, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(main_card), key_row, FALSE, FALSE, 0);
     
-    var textSelectors = platform === 'x' ?
-        'div[data-testid="tweetTextarea_0"],div[role="textbox"][contenteditable="true"]' :
-        platform === 'mastodon' ? 'textarea' : 'textarea,div[role="textbox"]';
+    // Gemini Model
+    GtkWidget* model_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget* model_label = gtk_label_new("Model:");
+    gtk_widget_set_size_request(model_label, 100, -1);
+    state->gemini_model_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(state->gemini_model_entry), state->settings.gemini_model.c_str());
+    gtk_box_pack_start(GTK_BOX(model_row), model_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(model_row), state->gemini_model_entry, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(main_card), model_row, FALSE, FALSE, 0);
     
-    var isUpdating = false;
+    // Hedged deadline
+    GtkWidget* deadline_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget* deadline_label = gtk_label_new("期限 (ms):");
+    gtk_widget_set_size_request(deadline_label, 100, -1);
+    state->deadline_spin = gtk_spin_button_new_with_range(100, 15000, 100);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(state->deadline_spin), state->settings.deadline_ms);
+    gtk_box_pack_start(GTK_BOX(deadline_row), deadline_label, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(deadline_row), state->deadline_spin, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(main_card), deadline_row, FALSE, FALSE, 0);
     
-    function attachToButtons() {
-        if(isUpdating) return;
-        isUpdating = true;
+    // Checkboxes
+    GtkWidget* check_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 16);
+    gtk_widget_set_halign(check_row, GTK_ALIGN_CENTER);
+    state->toggle_analysis = gtk_check_button_new_with_label("高度分析");
+    state->toggle_pattern = gtk_check_button_new_with_label("パターン検知");
+    state->toggle_annotate = gtk_check_button_new_with_label("タイムライン注釈");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(state->toggle_analysis), state->settings.enable_analysis);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(state->toggle_pattern), state->settings.enable_pattern);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(state->toggle_annotate), state->settings.annotate_timeline);
+    gtk_box_pack_start(GTK_BOX(check_row), state->toggle_analysis, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(check_row), state->toggle_pattern, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(check_row), state->toggle_annotate, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(main_card), check_row, FALSE, FALSE, 8);
+    
+    gtk_box_pack_start(GTK_BOX(page), main_card, FALSE, FALSE, 0);
+    
+    // Apply button
+    GtkWidget* apply_btn = gtk_button_new_with_label("設定を適用");
+    gtk_style_context_add_class(gtk_widget_get_style_context(apply_btn), "apply-button");
+    gtk_widget_set_size_request(apply_btn, 250, 50);
+    gtk_widget_set_halign(apply_btn, GTK_ALIGN_CENTER);
+    gtk_box_pack_start(GTK_BOX(page), apply_btn, FALSE, FALSE, 16);
+
+    g_signal_connect(apply_btn, "clicked", G_CALLBACK(+[](GtkButton*, gpointer data){
+        auto* st = static_cast<AppState*>(data);
         
-        var buttons = document.querySelectorAll(buttonSelectors);
+        const char* api = gtk_entry_get_text(GTK_ENTRY(st->api_entry));
+        st->settings.api_url = api ? api : "";
         
-        buttons.forEach(function(btn) {
-            if(btn.dataset.sgBound === 'true') return;
-            btn.dataset.sgBound = 'true';
-            console.log('[SNS Guardian] Attached to button');
-            
-            btn.addEventListener('click', async function(e) {
-                if(btn.dataset.sgBypass === 'true') return;
-                
-                e.preventDefault();
-                e.stopPropagation();
-                
-                var textEl = document.querySelector(textSelectors);
-                var text = textEl ? (textEl.textContent || textEl.value || '') : '';
-                console.log('[SNS Guardian] Intercepted, text:', text.substring(0, 30));
-                
-                var analysis = await analyzeRisk(text);
-                
-                showModal(analysis, 
-                    function() {
-                        btn.dataset.sgBypass = 'true';
-                        btn.click();
-                        setTimeout(function() { btn.dataset.sgBypass = 'false'; }, 500);
-                    },
-                    function() {}
-                );
-            }, true);
-        });
+        const char* provider_id = gtk_combo_box_get_active_id(GTK_COMBO_BOX(st->provider_combo));
+        st->settings.provider = string_to_provider(provider_id ? provider_id : "local");
         
-        isUpdating = false;
-    }
-    
-    attachToButtons();
-    
-    var debounceTimer = null;
-    var observer = new MutationObserver(function() {
-        if(debounceTimer) clearTimeout(debounceTimer);
-        debounceTimer = setTimeout(attachToButtons, 500);
-    });
-    observer.observe(document.body, { childList: true, subtree: true });
-    
-    console.log('[SNS Guardian] Initialization complete');
-})();
-)JS";
+        const char* gemini_key = gtk_entry_get_text(GTK_ENTRY(st->gemini_key_entry));
+        st->gemini_api_key = gemini_key ? gemini_key : "";
+        st->settings.gemini_configured = !st->gemini_api_key.empty();
         
+        const char* gemini_model = gtk_entry_get_text(GTK_ENTRY(st->gemini_model_entry));
+        st->settings.gemini_model = (gemini_model && *gemini_model) ? gemini_model : "gemini-2.5-flash-lite-preview-09-2025";
+        
+        st->settings.enable_analysis = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(st->toggle_analysis));
+        st->settings.enable_pattern = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(st->toggle_pattern));
+        st->settings.annotate_timeline = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(st->toggle_annotate));
+        st->settings.deadline_ms = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(st->deadline_spin));
+
+        g_print("\n[SNS Guardian] Settings applied:\n");
+        g_print("  Provider: %s\n", provider_to_string(st->settings.provider).c_str());
+        g_print("  API Key: %s\n", st->gemini_api_key.empty() ? "(not set)" : "(set)");
+        g_print("  Model: %s\n", st->settings.gemini_model.c_str());
+        g_print("  Deadline: %d ms\n", st->settings.deadline_ms);
+
+        if (st->use_web_extension) {
+            webkit_web_context_send_message_to_all_extensions(st->web_context,
+                webkit_user_message_new("guardian-settings", settings_to_variant(st->settings)));
+        }
+
+        // beforeunloadを無効化してから強制リロード
+        const char* disable_beforeunload = "window.onbeforeunload = null; window.addEventListener('beforeunload', function(e) { e.stopImmediatePropagation(); }, true);";
         webkit_web_view_evaluate_javascript(
-            WEBKIT_WEB_VIEW(state->web_view),
-            script.str().c_str(),
-            -1, nullptr, nullptr, nullptr, nullptr, nullptr
+            WEBKIT_WEB_VIEW(st->web_view),
+            disable_beforeunload,
+            -1, nullptr, nullptr, nullptr,
+            +[](GObject* source, GAsyncResult* result, gpointer user_data) {
+                auto* web_view = WEBKIT_WEB_VIEW(source);
+                webkit_web_view_evaluate_javascript_finish(web_view, result, nullptr);
+                webkit_web_view_reload_bypass_cache(web_view);
+            },
+            nullptr
         );
+        
+        if(st->notebook) gtk_notebook_set_current_page(GTK_NOTEBOOK(st->notebook), 0);
+    }), state);
+
+    gtk_widget_show_all(page);
+    trace_phase(state->trace, "settings_page", phase_start);
+    trace_write(state->trace);
+}
+
+// スクリプト注入モード用。ページ側のガーディアンからの Gemini / REST / バッチ採点メッセージを受け取る
+void register_guardian_message_handlers(WebKitUserContentManager* content_manager, AppState* state) {
+    // Gemini / REST API message handlers
+    for (const char* handler : {"gemini", "rest"}) {
+        webkit_user_content_manager_register_script_message_handler(content_manager, handler);
+        std::string signal = std::string("script-message-received::") + handler;
+        g_signal_connect(content_manager, signal.c_str(), G_CALLBACK(+[](WebKitUserContentManager*, WebKitJavascriptResult* js_result, gpointer data) {
+            auto* st = static_cast<AppState*>(data);
+            JSCValue* value = webkit_javascript_result_get_js_value(js_result);
+            if (!jsc_value_is_object(value)) return;
+
+            int id = jsc_int_property(value, "id");
+            std::string handler_name = jsc_string_property(value, "handler");
+            std::string text = jsc_string_property(value, "text");
+            std::string reply_context = jsc_string_property(value, "replyTo");
+            std::string platform = jsc_string_property(value, "platform");
+            
+            g_print("[SNS Guardian C++] Received %s request %d, length: %zu, reply context: %zu\n", handler_name.c_str(), id, text.length(), reply_context.length());
+            start_remote_analysis(st, id, make_remote_fetch(st, handler_name, text, reply_context, platform), deliver_to_page(st, id));
+        }), state);
     }
+
+    // 期限付き並列評価で負けたリクエストの中止
+    webkit_user_content_manager_register_script_message_handler(content_manager, "cancelRemote");
+    g_signal_connect(content_manager, "script-message-received::cancelRemote", G_CALLBACK(+[](WebKitUserContentManager*, WebKitJavascriptResult* js_result, gpointer data) {
+        JSCValue* value = webkit_javascript_result_get_js_value(js_result);
+        if (jsc_value_is_number(value)) cancel_remote_analysis(static_cast<AppState*>(data), jsc_value_to_int32(value));
+    }), state);
+
+    // Timeline batch scoring handler
+    webkit_user_content_manager_register_script_message_handler(content_manager, "guardianBatch");
+    g_signal_connect(content_manager, "script-message-received::guardianBatch", G_CALLBACK(+[](WebKitUserContentManager*, WebKitJavascriptResult* js_result, gpointer data) {
+        auto* st = static_cast<AppState*>(data);
+        JSCValue* value = webkit_javascript_result_get_js_value(js_result);
+        std::vector<std::pair<std::string, std::string>> posts = posts_from_jsc(value);
+        if (posts.empty()) return;
+
+        std::thread([st, posts = std::move(posts)]() {
+            std::string results = score_posts_json(posts);
+
+            g_idle_add(+[](gpointer user_data) -> gboolean {
+                auto* params = static_cast<std::pair<AppState*, std::string>*>(user_data);
+                std::string callback_js = "if(window.guardianBatchCallback) window.guardianBatchCallback(" + params->second + ");";
+                webkit_web_view_evaluate_javascript(WEBKIT_WEB_VIEW(params->first->web_view), callback_js.c_str(), -1, nullptr, nullptr, nullptr, nullptr, nullptr);
+                delete params;
+                return FALSE;
+            }, new std::pair<AppState*, std::string>(st, results));
+        }).detach();
+    }), state);
 }
 
 } // namespace
 
 int main(int argc, char* argv[]) {
+    AppState state;
+    state.trace.origin = g_get_monotonic_time();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--trace-startup") {
+            state.trace.enabled = true;
+        } else if (arg.rfind("--trace-startup=", 0) == 0) {
+            state.trace.enabled = true;
+            state.trace.path = arg.substr(std::string("--trace-startup=").length());
+        }
+    }
+
+    gint64 phase_start = g_get_monotonic_time();
     gtk_init(&argc, &argv);
+    trace_phase(state.trace, "gtk_init", phase_start);
 
-    AppState state;
     state.settings = load_settings_from_env();
+    if (const char* key = std::getenv("SNS_GUARDIAN_GEMINI_API_KEY")) state.gemini_api_key = key;
+    state.settings.gemini_configured = !state.gemini_api_key.empty();
 
     state.window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(state.window), "SNS Guardian Browser");
@@ -469,7 +814,9 @@ int main(int argc, char* argv[]) {
 
     g_signal_connect(state.window, "destroy", G_CALLBACK(gtk_main_quit), nullptr);
 
-    // CSS
+    // CSS (設定タブ内だけのルールは build_settings_page() で読み込む。
+    // WebKit のコンテキストメニューや <select> のポップアップも GTK のメニューなので menu / menuitem はここに置く)
+    phase_start = g_get_monotonic_time();
     GtkCssProvider* css_provider = gtk_css_provider_new();
     const char* css = R"CSS(
         * { -gtk-icon-style: symbolic; }
@@ -484,29 +831,17 @@ int main(int argc, char* argv[]) {
         notebook header tab { background-color: #1a1a2e; background-image: none; color: #888899; padding: 12px 24px; border-radius: 8px 8px 0 0; border: 1px solid #2a2a4a; font-weight: bold; }
         notebook header tab:checked { background-color: #00fff2; background-image: none; color: #0a0a0f; }
         notebook > stack { background-color: #0a0a0f; }
-        .settings-page { background-color: #0a0a0f; padding: 16px; }
-        .settings-card { background-color: #12121a; border: 2px solid #00fff2; border-radius: 12px; padding: 16px; margin: 6px 0; }
-        .section-title { color: #00fff2; font-size: 15px; font-weight: bold; }
         label, .settings-label { color: #ddddee; background-color: transparent; }
-        entry { background-color: #1a1a2e; background-image: none; border: 2px solid #4a4a6a; border-radius: 6px; padding: 8px; color: #ffffff; min-height: 16px; }
-        entry:focus { border-color: #ff00ff; }
-        combobox, combobox * { background-color: #1a1a2e; color: #ffffff; }
-        combobox button { background-color: #1a1a2e; background-image: none; border: 2px solid #4a4a6a; border-radius: 6px; color: #ffffff; }
-        combobox button:hover { border-color: #00fff2; background-color: #2a2a4a; }
-        combobox cellview { background-color: transparent; color: #ffffff; }
         menu, popover { background-color: #1a1a2e; border: 2px solid #00fff2; border-radius: 8px; }
         menuitem { background-color: #1a1a2e; color: #ffffff; padding: 8px 12px; }
         menuitem:hover { background-color: #00fff2; color: #0a0a0f; }
-        checkbutton { color: #ddddee; }
-        checkbutton check { background-color: #1a1a2e; background-image: none; border: 2px solid #4a4a6a; border-radius: 4px; }
-        checkbutton:checked check { background-color: #ff00ff; border-color: #ff00ff; }
-        .apply-button { background-image: linear-gradient(135deg, #ff00ff, #00fff2); background-color: #ff00ff; border: none; border-radius: 8px; padding: 12px 28px; color: #ffffff; font-weight: bold; min-height: 40px; }
-        .apply-button:hover { background-image: linear-gradient(135deg, #ff44ff, #44ffff); }
     )CSS";
     
     gtk_css_provider_load_from_data(css_provider, css, -1, nullptr);
     gtk_style_context_add_provider_for_screen(gdk_screen_get_default(), GTK_STYLE_PROVIDER(css_provider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+    trace_phase(state.trace, "css", phase_start);
 
+    phase_start = g_get_monotonic_time();
     GtkWidget* vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
     gtk_container_add(GTK_CONTAINER(state.window), vbox);
 
@@ -531,7 +866,10 @@ int main(int argc, char* argv[]) {
     gtk_box_pack_start(GTK_BOX(nav_box), btn_mastodon, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(nav_box), btn_bluesky, FALSE, FALSE, 0);
 
+    trace_phase(state.trace, "widgets", phase_start);
+
     // Session persistence
+    phase_start = g_get_monotonic_time();
     std::string data_dir = std::string(g_get_home_dir()) + "/.sns_guardian_browser";
     WebKitWebsiteDataManager* data_manager = webkit_website_data_manager_new(
         "base-data-directory", data_dir.c_str(),
@@ -544,35 +882,30 @@ int main(int argc, char* argv[]) {
     webkit_cookie_manager_set_accept_policy(cookie_manager, WEBKIT_COOKIE_POLICY_ACCEPT_ALWAYS);
     
     WebKitWebContext* web_context = webkit_web_context_new_with_website_data_manager(data_manager);
+    state.web_context = web_context;
+    
+    // Web process extension
+    const char* extension_dir_env = std::getenv("SNS_GUARDIAN_EXTENSION_DIR");
+    std::string extension_dir = extension_dir_env ? extension_dir_env : SNS_GUARDIAN_EXTENSION_DIR;
+    std::string extension_path = extension_dir + "/libsns_guardian_extension.so";
+    state.use_web_extension = parse_bool_env(std::getenv("SNS_GUARDIAN_WEB_EXTENSION"), true);
+    if (state.use_web_extension && !g_file_test(extension_path.c_str(), G_FILE_TEST_EXISTS)) {
+        g_print("[SNS Guardian] Web extension not found at %s, falling back to script injection\n", extension_path.c_str());
+        state.use_web_extension = false;
+    }
+    if (state.use_web_extension) {
+        g_print("[SNS Guardian] Using web extension: %s\n", extension_path.c_str());
+        webkit_web_context_set_web_extensions_directory(web_context, extension_dir.c_str());
+        g_signal_connect(web_context, "initialize-web-extensions", G_CALLBACK(+[](WebKitWebContext* context, gpointer data) {
+            auto* st = static_cast<AppState*>(data);
+            webkit_web_context_set_web_extensions_initialization_user_data(context, settings_to_variant(st->settings));
+        }), &state);
+    }
+    
     WebKitUserContentManager* content_manager = webkit_user_content_manager_new();
     
-    // Gemini message handler
-    webkit_user_content_manager_register_script_message_handler(content_manager, "gemini");
-    g_signal_connect(content_manager, "script-message-received::gemini", G_CALLBACK(+[](WebKitUserContentManager*, WebKitJavascriptResult* js_result, gpointer data) {
-        auto* st = static_cast<AppState*>(data);
-        JSCValue* value = webkit_javascript_result_get_js_value(js_result);
-        if (jsc_value_is_string(value)) {
-            char* text_c = jsc_value_to_string(value);
-            std::string text = text_c;
-            g_free(text_c);
-            
-            g_print("[SNS Guardian C++] Received message from JS, length: %zu\n", text.length());
-            
-            std::thread([st, text]() {
-                std::string result_json = perform_gemini_request(st->settings.gemini_api_key, st->settings.gemini_model, text);
-                std::string content = extract_gemini_text(result_json);
-                if (content.empty()) content = result_json;
-                
-                g_idle_add(+[](gpointer user_data) -> gboolean {
-                    auto* params = static_cast<std::pair<AppState*, std::string>*>(user_data);
-                    std::string callback_js = "if(window.geminiCallback) window.geminiCallback(`" + js_escape(params->second) + "`);";
-                    webkit_web_view_evaluate_javascript(WEBKIT_WEB_VIEW(params->first->web_view), callback_js.c_str(), -1, nullptr, nullptr, nullptr, nullptr, nullptr);
-                    delete params;
-                    return FALSE;
-                }, new std::pair<AppState*, std::string>(st, content));
-            }).detach();
-        }
-    }), &state);
+    // 拡張モードではページから届くメッセージを受け付けない（ガーディアンは guardian-remote / guardian-cancel で UI プロセスと通信する）
+    if (!state.use_web_extension) register_guardian_message_handlers(content_manager, &state);
 
     state.web_view = GTK_WIDGET(g_object_new(WEBKIT_TYPE_WEB_VIEW,
         "web-context", web_context,
@@ -590,138 +923,43 @@ int main(int argc, char* argv[]) {
     g_signal_connect(btn_bluesky, "clicked", G_CALLBACK(+[](GtkButton*, gpointer data){ navigate_to(static_cast<AppState*>(data), "https://bsky.app"); }), &state);
 
     g_signal_connect(state.web_view, "load-changed", G_CALLBACK(on_load_changed), &state);
+    g_signal_connect(state.web_view, "user-message-received", G_CALLBACK(on_user_message_received), &state);
+    trace_phase(state.trace, "web_context", phase_start);
+
+    if (state.trace.enabled) {
+        state.trace.paint_handler = g_signal_connect_after(state.web_view, "draw", G_CALLBACK(+[](GtkWidget* widget, cairo_t*, gpointer data) -> gboolean {
+            auto* st = static_cast<AppState*>(data);
+            if (!st->trace.load_committed) return FALSE;
+            trace_mark(st->trace, "first_paint");
+            trace_write(st->trace);
+            g_signal_handler_disconnect(widget, st->trace.paint_handler);
+            st->trace.paint_handler = 0;
+            return FALSE;
+        }), &state);
+    }
+    // 残りのウィジェット構築より先に最初の読み込みを始める
+    webkit_web_view_load_uri(WEBKIT_WEB_VIEW(state.web_view), "https://x.com");
+    trace_mark(state.trace, "load_start");
 
     GtkWidget* label_browser = gtk_label_new("SNS");
     gtk_notebook_append_page(GTK_NOTEBOOK(notebook), page_browser, label_browser);
 
-    // Page 2: Settings
-    GtkWidget* page_settings = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
-    gtk_style_context_add_class(gtk_widget_get_style_context(page_settings), "settings-page");
-    gtk_container_set_border_width(GTK_CONTAINER(page_settings), 16);
-    
-    GtkWidget* title_label = gtk_label_new("SNS GUARDIAN 設定");
-    gtk_style_context_add_class(gtk_widget_get_style_context(title_label), "section-title");
-    PangoAttrList* title_attrs = pango_attr_list_new();
-    pango_attr_list_insert(title_attrs, pango_attr_scale_new(2.0));
-    pango_attr_list_insert(title_attrs, pango_attr_weight_new(PANGO_WEIGHT_BOLD));
-    gtk_label_set_attributes(GTK_LABEL(title_label), title_attrs);
-    pango_attr_list_unref(title_attrs);
-    gtk_widget_set_halign(title_label, GTK_ALIGN_CENTER);
-    gtk_box_pack_start(GTK_BOX(page_settings), title_label, FALSE, FALSE, 8);
-    
-    GtkWidget* main_card = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
-    gtk_style_context_add_class(gtk_widget_get_style_context(main_card), "settings-card");
-    
-    // Provider
-    GtkWidget* provider_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
-    GtkWidget* provider_label = gtk_label_new("プロバイダ:");
-    gtk_widget_set_size_request(provider_label, 100, -1);
-    state.provider_combo = gtk_combo_box_text_new();
-    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(state.provider_combo), "local", "ローカル");
-    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(state.provider_combo), "gemini", "Gemini API");
-    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(state.provider_combo), "api", "REST API");
-    gtk_combo_box_set_active_id(GTK_COMBO_BOX(state.provider_combo), provider_to_string(state.settings.provider).c_str());
-    gtk_box_pack_start(GTK_BOX(provider_row), provider_label, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(provider_row), state.provider_combo, TRUE, TRUE, 0);
-    gtk_box_pack_start(GTK_BOX(main_card), provider_row, FALSE, FALSE, 0);
-    
-    // API URL
-    GtkWidget* api_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
-    GtkWidget* api_label = gtk_label_new("API URL:");
-    gtk_widget_set_size_request(api_label, 100, -1);
-    state.api_entry = gtk_entry_new();
-    gtk_entry_set_text(GTK_ENTRY(state.api_entry), state.settings.api_url.c_str());
-    gtk_box_pack_start(GTK_BOX(api_row), api_label, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(api_row), state.api_entry, TRUE, TRUE, 0);
-    gtk_box_pack_start(GTK_BOX(main_card), api_row, FALSE, FALSE, 0);
-    
-    // Gemini API Key
-    GtkWidget* key_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
-    GtkWidget* key_label = gtk_label_new("API Key:");
-    gtk_widget_set_size_request(key_label, 100, -1);
-    state.gemini_key_entry = gtk_entry_new();
-    gtk_entry_set_visibility(GTK_ENTRY(state.gemini_key_entry), FALSE);
-    gtk_entry_set_text(GTK_ENTRY(state.gemini_key_entry), state.settings.gemini_api_key.c_str());
-    gtk_box_pack_start(GTK_BOX(key_row), key_label, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(key_row), state.gemini_key_entry, TRUE, TRUE, 0);
-    gtk_box_pack_start(GTK_BOX(main_card), key_row, FALSE, FALSE, 0);
-    
-    // Gemini Model
-    GtkWidget* model_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
-    GtkWidget* model_label = gtk_label_new("Model:");
-    gtk_widget_set_size_request(model_label, 100, -1);
-    state.gemini_model_entry = gtk_entry_new();
-    gtk_entry_set_text(GTK_ENTRY(state.gemini_model_entry), state.settings.gemini_model.c_str());
-    gtk_box_pack_start(GTK_BOX(model_row), model_label, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(model_row), state.gemini_model_entry, TRUE, TRUE, 0);
-    gtk_box_pack_start(GTK_BOX(main_card), model_row, FALSE, FALSE, 0);
-    
-    // Checkboxes
-    GtkWidget* check_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 16);
-    gtk_widget_set_halign(check_row, GTK_ALIGN_CENTER);
-    state.toggle_analysis = gtk_check_button_new_with_label("高度分析");
-    state.toggle_pattern = gtk_check_button_new_with_label("パターン検知");
-    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(state.toggle_analysis), state.settings.enable_analysis);
-    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(state.toggle_pattern), state.settings.enable_pattern);
-    gtk_box_pack_start(GTK_BOX(check_row), state.toggle_analysis, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(check_row), state.toggle_pattern, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(main_card), check_row, FALSE, FALSE, 8);
-    
-    gtk_box_pack_start(GTK_BOX(page_settings), main_card, FALSE, FALSE, 0);
-    
-    // Apply button
-    GtkWidget* apply_btn = gtk_button_new_with_label("設定を適用");
-    gtk_style_context_add_class(gtk_widget_get_style_context(apply_btn), "apply-button");
-    gtk_widget_set_size_request(apply_btn, 250, 50);
-    gtk_widget_set_halign(apply_btn, GTK_ALIGN_CENTER);
-    gtk_box_pack_start(GTK_BOX(page_settings), apply_btn, FALSE, FALSE, 16);
-
-    g_signal_connect(apply_btn, "clicked", G_CALLBACK(+[](GtkButton*, gpointer data){
+    // Page 2: Settings (中身は初めてタブが開かれたときに作る)
+    state.settings_page = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
+    gtk_style_context_add_class(gtk_widget_get_style_context(state.settings_page), "settings-page");
+    gtk_container_set_border_width(GTK_CONTAINER(state.settings_page), 16);
+    g_signal_connect(notebook, "switch-page", G_CALLBACK(+[](GtkNotebook*, GtkWidget* page, guint, gpointer data) {
         auto* st = static_cast<AppState*>(data);
-        
-        const char* api = gtk_entry_get_text(GTK_ENTRY(st->api_entry));
-        st->settings.api_url = api ? api : "";
-        
-        const char* provider_id = gtk_combo_box_get_active_id(GTK_COMBO_BOX(st->provider_combo));
-        st->settings.provider = string_to_provider(provider_id ? provider_id : "local");
-        
-        const char* gemini_key = gtk_entry_get_text(GTK_ENTRY(st->gemini_key_entry));
-        st->settings.gemini_api_key = gemini_key ? gemini_key : "";
-        
-        const char* gemini_model = gtk_entry_get_text(GTK_ENTRY(st->gemini_model_entry));
-        st->settings.gemini_model = (gemini_model && *gemini_model) ? gemini_model : "gemini-2.5-flash-lite-preview-09-2025";
-        
-        st->settings.enable_analysis = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(st->toggle_analysis));
-        st->settings.enable_pattern = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(st->toggle_pattern));
-
-        g_print("\n[SNS Guardian] Settings applied:\n");
-        g_print("  Provider: %s\n", provider_to_string(st->settings.provider).c_str());
-        g_print("  API Key: %s\n", st->settings.gemini_api_key.empty() ? "(not set)" : "(set)");
-        g_print("  Model: %s\n", st->settings.gemini_model.c_str());
-
-        // beforeunloadを無効化してから強制リロード
-        const char* disable_beforeunload = "window.onbeforeunload = null; window.addEventListener('beforeunload', function(e) { e.stopImmediatePropagation(); }, true);";
-        webkit_web_view_evaluate_javascript(
-            WEBKIT_WEB_VIEW(st->web_view),
-            disable_beforeunload,
-            -1, nullptr, nullptr, nullptr,
-            +[](GObject* source, GAsyncResult* result, gpointer user_data) {
-                auto* web_view = WEBKIT_WEB_VIEW(source);
-                webkit_web_view_evaluate_javascript_finish(web_view, result, nullptr);
-                webkit_web_view_reload_bypass_cache(web_view);
-            },
-            nullptr
-        );
-        
-        if(st->notebook) gtk_notebook_set_current_page(GTK_NOTEBOOK(st->notebook), 0);
+        if (page == st->settings_page && !st->settings_built) build_settings_page(st);
     }), &state);
 
     GtkWidget* label_settings = gtk_label_new("設定");
-    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), page_settings, label_settings);
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), state.settings_page, label_settings);
 
+    phase_start = g_get_monotonic_time();
     gtk_widget_show_all(state.window);
+    trace_phase(state.trace, "show_window", phase_start);
 
-    webkit_web_view_load_uri(WEBKIT_WEB_VIEW(state.web_view), "https://x.com");
     gtk_widget_grab_focus(state.web_view);
 
     // Ctrl+V support